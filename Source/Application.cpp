@@ -52,6 +52,9 @@ ConsoleVar demo_gamepath("demo_gamepath"_s, "D:\\Games\\Blade Of Darkness"_s);
 ConsoleVar demo_gamelevel("demo_gamelevel"_s, "Maps/Casa/casa.lvl"_s);
 ConsoleVar demo_spectatorMoveSpeed("demo_spectatorMoveSpeed"_s, "10"_s);
 ConsoleVar demo_music("demo_music"_s, "Sounds/MAPA2.mp3"_s);
+ConsoleVar demo_loadProfile("demo_loadProfile"_s, ""_s); // If set, the level load profile is written to this JSON file
+ConsoleVar demo_levelCache("demo_levelCache"_s, "LevelCache"_s); // Directory for compiled levels and compressed textures. Empty disables the cache
+ConsoleVar demo_portalCulling("demo_portalCulling"_s, "2"_s); // Level sector culling: 0 - off, 1 - portal flooding, 2 - precomputed PVS
 
 class SpectatorComponent : public Component
 {
@@ -121,6 +124,17 @@ public:
     void DrawDebug(DebugRenderer& renderer);
 };
 
+// Updates level sector visibility from the camera of the owner
+class LevelVisibilityComponent : public Component
+{
+public:
+    static constexpr ComponentMode Mode = ComponentMode::Dynamic;
+
+    SampleApplication* App{};
+
+    void LateUpdate();
+};
+
 class SampleApplication final : public GameApplication
 {
     World*                      m_World{};
@@ -155,6 +169,7 @@ public:
         // Set rendering parameters
         m_WorldRenderView.Reset(new WorldRenderView);
         m_WorldRenderView->bDrawDebug = true;
+        m_WorldRenderView->VisibilityMask = ~(1u << BladeLevel::HiddenLayer);
         //m_WorldRenderView->bWireframe = true;
 
         // Create UI desktop
@@ -181,6 +196,9 @@ public:
         shortcuts->AddShortcut(VirtualKey::P, {}, {this, &SampleApplication::Pause});
         desktop->SetShortcuts(shortcuts);
 
+        // Add console commands
+        sGetCommandContext().AddCommand("level_profile"_s, {this, &SampleApplication::LevelProfile}, "Print level load profile. Usage: level_profile [json file]"_s);
+
         // Create game resources
         CreateResources();
 
@@ -199,6 +217,10 @@ public:
         input.BindInput(spectator->GetComponentHandle<SpectatorComponent>(), PlayerController::_1);
         input.SetActive(true);
 
+        LevelVisibilityComponent* levelVisibility;
+        spectator->CreateComponent(levelVisibility);
+        levelVisibility->App = this;
+
         RenderInterface& render = m_World->GetInterface<RenderInterface>();
         //render.SetAmbient(0.1f);
         render.SetAmbient(0);
@@ -268,6 +290,9 @@ public:
         
         model.Load(fileName);
 
+        // Decode all textures of the model in one batch instead of one by one in FindMaterial
+        m_Level.PrefetchTextures(model.TextureAtoms);
+
         // Build mesh
         Vector<Vector<MeshVertex>> vertexBatches(model.Textures.Size());
         Vector<Vector<uint32_t>> indexBatches(model.Textures.Size());
@@ -383,7 +408,7 @@ public:
             object->CreateComponent(mesh);
             mesh->SetMesh(surface);
             mesh->SetMaterial(materialMngr.FindMaterial("grid8")); // TODO
-            mesh->SetMaterial(m_Level.FindMaterial(model.Textures[textureNum]));
+            mesh->SetMaterial(m_Level.FindMaterial(model.TextureAtoms[textureNum]));
             mesh->SetCastShadow(false);
             mesh->SetLocalBoundingBox(bounds);
         }
@@ -393,42 +418,59 @@ public:
 
     void CreateScene()
     {
-        m_Level.LoadTextures( MakePath( "3DObjs/3dObjs.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/bolarayos.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/CilindroMagico.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/CilindroMagico2.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/CilindroMagico3.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/conos.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/dalblade.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/esferagemaazul.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/esferagemaroja.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/esferagemaverde.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/esferanegra.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/esferaorbital.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/espectro.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/firering.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/genericos.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/halfmoontrail.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/luzdivina.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/magicshield.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/nube.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/objetos_p.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/ondaexpansiva.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/Pfern.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/pmiguel.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/rail.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/telaranya.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/vortice.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DObjs/weapons.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/Actors.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/actors_javi.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/ork.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/Bar.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/Kgt.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/Kgtskin1.mmp" ) );
-        m_Level.LoadTextures( MakePath( "3DChars/Kgtskin2.mmp" ) );
-
-        m_Level.Load(m_World, MakePath(demo_gamelevel.GetString()));
+        String levelFileName = MakePath(demo_gamelevel.GetString());
+
+        // Startup texture packs are part of the level load profile
+        m_Level.ResetLoadProfile(levelFileName);
+
+        const char* texturePacks[] =
+        {
+            "3DObjs/3dObjs.mmp",
+            "3DObjs/bolarayos.mmp",
+            "3DObjs/CilindroMagico.mmp",
+            "3DObjs/CilindroMagico2.mmp",
+            "3DObjs/CilindroMagico3.mmp",
+            "3DObjs/conos.mmp",
+            "3DObjs/dalblade.mmp",
+            "3DObjs/esferagemaazul.mmp",
+            "3DObjs/esferagemaroja.mmp",
+            "3DObjs/esferagemaverde.mmp",
+            "3DObjs/esferanegra.mmp",
+            "3DObjs/esferaorbital.mmp",
+            "3DObjs/espectro.mmp",
+            "3DObjs/firering.mmp",
+            "3DObjs/genericos.mmp",
+            "3DObjs/halfmoontrail.mmp",
+            "3DObjs/luzdivina.mmp",
+            "3DObjs/magicshield.mmp",
+            "3DObjs/nube.mmp",
+            "3DObjs/objetos_p.mmp",
+            "3DObjs/ondaexpansiva.mmp",
+            "3DObjs/Pfern.mmp",
+            "3DObjs/pmiguel.mmp",
+            "3DObjs/rail.mmp",
+            "3DObjs/telaranya.mmp",
+            "3DObjs/vortice.mmp",
+            "3DObjs/weapons.mmp",
+            "3DChars/Actors.mmp",
+            "3DChars/actors_javi.mmp",
+            "3DChars/ork.mmp",
+            "3DChars/Bar.mmp",
+            "3DChars/Kgt.mmp",
+            "3DChars/Kgtskin1.mmp",
+            "3DChars/Kgtskin2.mmp"
+        };
+
+        Vector<String> texturePackPaths;
+        for (const char* texturePack : texturePacks)
+            texturePackPaths.Add(MakePath(texturePack));
+        m_Level.SetCacheDirectory(demo_levelCache.GetString());
+        m_Level.LoadTextures(texturePackPaths);
+
+        m_Level.Load(m_World, levelFileName);
+
+        if (!demo_loadProfile.GetString().IsEmpty())
+            m_Level.GetLoadProfile().WriteJson(demo_loadProfile.GetString());
 
         
 
@@ -517,6 +559,35 @@ public:
         PostTerminateEvent();
     }
 
+    void LevelProfile(CommandProcessor const& proc)
+    {
+        LoadProfile const& profile = m_Level.GetLoadProfile();
+
+        profile.Print();
+
+        if (proc.GetArgsCount() > 1)
+        {
+            if (!profile.WriteJson(proc.GetArg(1)))
+                LOG("Failed to write {}\n", proc.GetArg(1));
+        }
+    }
+
+    void UpdateLevelVisibility(GameObject* viewer)
+    {
+        CameraComponent* camera = viewer->GetComponent<CameraComponent>();
+        if (!camera)
+            return;
+
+        Float3 viewPosition = viewer->GetWorldPosition();
+
+        PlaneF frustum[4];
+        PortalCulling::sGetFrustumPlanes(viewPosition, viewer->GetForwardVector(), viewer->GetRightVector(), viewer->GetUpVector(), camera->GetFovX(), camera->GetFovY(), frustum);
+
+        m_Level.SetPortalCulling(demo_portalCulling.GetInteger() != 0);
+        m_Level.SetUsePVS(demo_portalCulling.GetInteger() == 2);
+        m_Level.UpdateVisibility(viewPosition, frustum, 4);
+    }
+
     Vector<Float3> m_TempPoints;
 
     void DrawDebug(DebugRenderer& renderer)
@@ -599,5 +670,11 @@ void DebugRendererComponent::DrawDebug(DebugRenderer& renderer)
         App->DrawDebug(renderer);
 }
 
+void LevelVisibilityComponent::LateUpdate()
+{
+    if (App)
+        App->UpdateLevelVisibility(GetOwner());
+}
+
 using ApplicationClass = SampleApplication;
 #include "Samples/Source/Common/EntryPoint.h"
@@ -38,6 +38,7 @@ void BladeModel::Clear()
     Bones.Clear();
     Anchors.Clear();
     Textures.Clear();
+    TextureAtoms.Clear();
 }
 
 void BladeModel::Load(StringView fileName)
@@ -57,16 +58,22 @@ void BladeModel::Load(StringView fileName)
         v.Normal = f.ReadObject<Double3>();
     }
 
-    auto ReadTextureName = [this](File& f) -> int
+    HashMap<NameAtom, int> textureNumByAtom;
+
+    auto ReadTextureName = [this, &textureNumByAtom](File& f) -> int
         {
             String name = f.ReadString();
-            for (int i = 0, count = Textures.Size(); i < count; ++i)
-            {
-                if (!Textures[i].Icmp(name))
-                    return i;
-            }
+            NameAtom atom = NameTable::Intern(name);
+
+            auto it = textureNumByAtom.Find(atom);
+            if (it != textureNumByAtom.End())
+                return it->second;
+
+            int textureNum = Textures.Size();
             Textures.Add(std::move(name));
-            return Textures.Size() - 1;
+            TextureAtoms.Add(atom);
+            textureNumByAtom[atom] = textureNum;
+            return textureNum;
         };
 
     int faceCount = f.ReadInt32();
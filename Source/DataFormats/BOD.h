@@ -31,6 +31,9 @@ SOFTWARE.
 #include <Hork/Geometry/BV/BvAxisAlignedBox.h>
 #include <Hork/Math/Plane.h>
 #include <Hork/Core/Containers/Vector.h>
+#include <Hork/Core/Containers/Hash.h>
+
+#include "../Utils/NameTable.h"
 
 using namespace Hk;
 
@@ -123,6 +126,7 @@ public:
     Vector<int32_t> Mutilations;
     Vector<Trail> Trails;
     Vector<String> Textures;
+    Vector<NameAtom> TextureAtoms;
 
     double UnknownDbl0;
     double UnknownDbl1;
@@ -27,7 +27,10 @@ SOFTWARE.
 */
 
 #include "BW.h"
-#include "../Utils/FileDump.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/ParallelFor.h"
+
+#include <atomic>
 
 using namespace Hk;
 
@@ -35,58 +38,164 @@ bool BladeWorld::Load(StringView fileName)
 {
     Clear();
 
-    File file = File::sOpenRead(fileName);
-    if (!file)
+    MappedFile file;
+    if (!file.Open(fileName))
         return false;
 
-    m_Atmospheres.Resize(file.ReadInt32());
+    MemoryCursor cursor(file.GetData(), file.GetSize());
+
+    m_Atmospheres.Resize(cursor.ReadInt32());
     for (auto& atmo : m_Atmospheres)
     {
-        atmo.Name = file.ReadString();
-        file.Read(&atmo.Color[0], 3);
-        atmo.Opacity = file.ReadFloat();
+        atmo.Name = cursor.ReadString();
+        atmo.Atom = NameTable::Intern(atmo.Name);
+        cursor.Read(&atmo.Color[0], 3);
+        atmo.Opacity = cursor.ReadFloat();
     }
 
-    m_Vertices.Resize(file.ReadInt32());
-    for (auto& vertex : m_Vertices)
+    static_assert(sizeof(Double3) == sizeof(double) * 3, "Unexpected Double3 layout");
+
+    m_Vertices.Resize(cursor.ReadInt32());
+    if (!cursor.ReadArray(m_Vertices.ToPtr(), m_Vertices.Size()))
     {
-        vertex.X = file.ReadDouble();
-        vertex.Y = file.ReadDouble();
-        vertex.Z = file.ReadDouble();
+        LOG("BladeWorld::Load: Unexpected end of file {}\n", fileName);
+        Clear();
+        return false;
     }
 
-    m_Sectors.Resize(file.ReadInt32());
-
-    for (uint32_t sectorIndex = 0; sectorIndex < m_Sectors.Size(); ++sectorIndex)
+    int32_t sectorCount = cursor.ReadInt32();
+    if (sectorCount < 0)
+        sectorCount = 0;
+
+    // Pass 1: find where each sector starts and how many faces, portals, nodes and planes it produces
+    Vector<SectorLayout> layouts;
+    layouts.Reserve(sectorCount);
+
+    uint32_t faceCount = 0;
+    uint32_t portalCount = 0;
+    uint32_t nodeCount = 0;
+    uint32_t planeCount = 0;
+    uint32_t leafEntryCount = 0;
+    uint32_t leafIndexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t holeCount = 0;
+    uint32_t tangentPlaneCount = 0;
+
+    for (int32_t sectorIndex = 0; sectorIndex < sectorCount; ++sectorIndex)
     {
-        if (!ReadSector(file, sectorIndex))
+        SectorLayout layout = {};
+        layout.Offset = cursor.GetOffset();
+        layout.FirstFace = faceCount;
+        layout.FirstPortal = portalCount;
+        layout.FirstNode = nodeCount;
+        layout.FirstPlane = planeCount;
+        layout.FirstTextureRef = m_TextureRefs.Size();
+        layout.FirstLeafEntry = leafEntryCount;
+        layout.FirstLeafIndex = leafIndexCount;
+        layout.FirstIndex = indexCount;
+        layout.FirstHole = holeCount;
+        layout.FirstTangentPlane = tangentPlaneCount;
+
+        if (!ScanSector(cursor, layout))
         {
-            m_Sectors.Resize(sectorIndex);
+            LOG("WARNING: FILE READ ERROR.. SOMETHING GO WRONG!\n");
+            HK_ASSERT(0);
             break;
         }
+
+        faceCount += layout.FaceCount;
+        portalCount += layout.PortalCount;
+        nodeCount += layout.NodeCount;
+        planeCount += layout.PlaneCount;
+        leafEntryCount += layout.LeafEntryCount;
+        leafIndexCount += layout.LeafIndexCount;
+        indexCount += layout.IndexCount;
+        holeCount += layout.HoleCount;
+        tangentPlaneCount += layout.TangentPlaneCount;
+
+        layouts.Add(layout);
+    }
+
+    m_Sectors.Resize(layouts.Size());
+    m_Faces.Resize(faceCount);
+    m_Portals.Resize(portalCount);
+    m_BSPNodes.Resize(nodeCount);
+    m_Planes.Resize(planeCount);
+    m_LeafEntries.Resize(leafEntryCount);
+    m_LeafIndices.Resize(leafIndexCount);
+    m_Indices.Resize(indexCount);
+    m_Holes.Resize(holeCount);
+    m_TangentPlanes.Resize(tangentPlaneCount);
+
+    size_t sectorsEnd = cursor.GetOffset();
+
+    // Pass 2: decode sectors concurrently, each into its own ranges
+    std::atomic<bool> sectorsValid{true};
+
+    ParallelFor(layouts.Size(), [&](size_t sectorIndex)
+        {
+            SectorLayout const& layout = layouts[sectorIndex];
+
+            SectorCursor sectorCursor(file.GetData(), sectorsEnd);
+            sectorCursor.Seek(layout.Offset);
+            sectorCursor.SectorIndex = sectorIndex;
+            sectorCursor.NextFace = layout.FirstFace;
+            sectorCursor.NextPortal = layout.FirstPortal;
+            sectorCursor.NextNode = layout.FirstNode;
+            sectorCursor.NextPlane = layout.FirstPlane;
+            sectorCursor.NextTextureRef = layout.FirstTextureRef;
+            sectorCursor.NextLeafEntry = layout.FirstLeafEntry;
+            sectorCursor.NextLeafIndex = layout.FirstLeafIndex;
+            sectorCursor.NextIndex = layout.FirstIndex;
+            sectorCursor.NextHole = layout.FirstHole;
+            sectorCursor.NextTangentPlane = layout.FirstTangentPlane;
+
+            if (!ReadSector(sectorCursor))
+                sectorsValid.store(false, std::memory_order_relaxed);
+
+            HK_ASSERT(sectorCursor.NextFace == layout.FirstFace + layout.FaceCount);
+            HK_ASSERT(sectorCursor.NextPortal == layout.FirstPortal + layout.PortalCount);
+            HK_ASSERT(sectorCursor.NextNode == layout.FirstNode + layout.NodeCount);
+            HK_ASSERT(sectorCursor.NextPlane == layout.FirstPlane + layout.PlaneCount);
+            HK_ASSERT(sectorCursor.NextLeafEntry == layout.FirstLeafEntry + layout.LeafEntryCount);
+            HK_ASSERT(sectorCursor.NextLeafIndex == layout.FirstLeafIndex + layout.LeafIndexCount);
+            HK_ASSERT(sectorCursor.NextIndex == layout.FirstIndex + layout.IndexCount);
+            HK_ASSERT(sectorCursor.NextHole == layout.FirstHole + layout.HoleCount);
+            HK_ASSERT(sectorCursor.NextTangentPlane == layout.FirstTangentPlane + layout.TangentPlaneCount);
+        });
+
+    m_TextureRefs.Clear();
+    m_TextureNumByAtom.Clear();
+
+    if (!sectorsValid.load())
+    {
+        LOG("BladeWorld::Load: Failed to read sectors {}\n", fileName);
+        Clear();
+        return false;
     }
 
-    m_Lights.Resize(file.ReadInt32());
+    DeduplicatePlanes();
+
+    m_Lights.Resize(cursor.ReadInt32());
     for (auto& light : m_Lights)
     {
-        light.Type = static_cast<LIGHT_TYPE>(file.ReadInt32());
+        light.Type = static_cast<LIGHT_TYPE>(cursor.ReadInt32());
 
-        file.Read(light.Color, 3);
-        light.Intensity = file.ReadFloat();
-        light.Unknown = file.ReadFloat();
+        cursor.Read(light.Color, 3);
+        light.Intensity = cursor.ReadFloat();
+        light.Unknown = cursor.ReadFloat();
 
         switch (light.Type)
         {
             case LT_POINT:
-                light.Position = file.ReadObject<Double3>();
-                light.Sector = file.ReadInt32();
+                light.Position = cursor.ReadObject<Double3>();
+                light.Sector = cursor.ReadInt32();
                 break;
             case LT_DIRECTIONAL:
-                file.SeekCur(36);
-                light.Direction = file.ReadObject<Double3>();
-                light.Sectors.Resize(file.ReadInt32());
-                for (int32_t& sectorIndex : light.Sectors)
-                    sectorIndex = file.ReadInt32();
+                cursor.Skip(36);
+                light.Direction = cursor.ReadObject<Double3>();
+                light.Sectors.Resize(cursor.ReadInt32());
+                cursor.ReadArray(light.Sectors.ToPtr(), light.Sectors.Size());
                 break;
             default:
                 HK_ASSERT(0);
@@ -94,17 +203,18 @@ bool BladeWorld::Load(StringView fileName)
         }
     }
 
-    file.ReadObject<Double3>();
-    file.ReadObject<Double3>();
+    cursor.ReadObject<Double3>();
+    cursor.ReadObject<Double3>();
 
     for (auto& sector : m_Sectors)
-        sector.Group = file.ReadInt32();
+        sector.Group = cursor.ReadInt32();
 
-    SetDumpLog(false);
-    int32_t strCount = file.ReadInt32();
+    int32_t strCount = cursor.ReadInt32();
     for (int32_t i = 0; i < strCount; ++i)
-        DumpString(file);
-    SetDumpLog(true);
+        cursor.ReadStringView();
+
+    if (!cursor.IsValid())
+        LOG("BladeWorld::Load: Unexpected end of file {}\n", fileName);
 
     return true;
 }
@@ -117,99 +227,342 @@ void BladeWorld::Clear()
     m_Faces.Clear();
     m_Portals.Clear();
     m_BSPNodes.Clear();
+    m_LeafEntries.Clear();
+    m_LeafIndices.Clear();
+    m_Indices.Clear();
+    m_Holes.Clear();
+    m_TangentPlanes.Clear();
     m_Planes.Clear();
     m_TextureNames.Clear();
+    m_TextureAtoms.Clear();
     m_Lights.Clear();
+    m_TextureRefs.Clear();
+    m_TextureNumByAtom.Clear();
 }
 
-bool BladeWorld::ReadSector(File& file, uint32_t sectorIndex)
+namespace
 {
-    Sector& sector = m_Sectors[sectorIndex];
+    constexpr double PlaneNormalEpsilon = 0.00001;
+    constexpr double PlaneDistEpsilon = 0.01;
 
-    SetDumpLog(true);
+    // Planes are hashed by distance. Buckets are wider than the epsilon, so only neighbor buckets need to be checked.
+    constexpr int PlaneHashSize = 4096;
+    constexpr double PlaneHashBucketSize = 8.0;
 
-    //LOG("-------Sector-------\n");
-    //DumpFileOffset(file);
+    HK_FORCEINLINE int PlaneHashKey(double dist)
+    {
+        return int(Math::Floor(dist / PlaneHashBucketSize)) & (PlaneHashSize - 1);
+    }
+
+    HK_FORCEINLINE bool ComparePlanes(PlaneD const& a, PlaneD const& b)
+    {
+        return Math::Abs(a.Normal.X - b.Normal.X) < PlaneNormalEpsilon &&
+               Math::Abs(a.Normal.Y - b.Normal.Y) < PlaneNormalEpsilon &&
+               Math::Abs(a.Normal.Z - b.Normal.Z) < PlaneNormalEpsilon &&
+               Math::Abs(a.D - b.D) < PlaneDistEpsilon;
+    }
+}
+
+void BladeWorld::DeduplicatePlanes()
+{
+    constexpr uint32_t InvalidPlane = ~0u;
+
+    uint32_t planeCount = m_Planes.Size();
+
+    Vector<uint32_t> hashHead(PlaneHashSize, InvalidPlane);
+    Vector<uint32_t> hashNext;
+    Vector<PlaneD> uniquePlanes;
+    Vector<int32_t> remap(planeCount);
 
-    sector.AtmosphereNum = [this](File& file) -> int32_t
+    hashNext.Reserve(planeCount);
+    uniquePlanes.Reserve(planeCount);
+
+    // The first occurrence becomes the canonical plane, so the result doesn't depend on hashing
+    for (uint32_t planeNum = 0; planeNum < planeCount; ++planeNum)
+    {
+        PlaneD const& plane = m_Planes[planeNum];
+
+        int key = PlaneHashKey(plane.D);
+
+        uint32_t found = InvalidPlane;
+        for (int i = -1; i <= 1 && found == InvalidPlane; ++i)
         {
-            String name = file.ReadString();
-            for (int32_t i = 0, count = m_Atmospheres.Size(); i < count; ++i)
+            for (uint32_t uniqueNum = hashHead[(key + i) & (PlaneHashSize - 1)]; uniqueNum != InvalidPlane; uniqueNum = hashNext[uniqueNum])
             {
-                if (!m_Atmospheres[i].Name.Icmp(name))
-                    return i;
+                if (ComparePlanes(uniquePlanes[uniqueNum], plane))
+                {
+                    found = uniqueNum;
+                    break;
+                }
             }
-            return -1;
-        }(file);
+        }
+
+        if (found == InvalidPlane)
+        {
+            found = uniquePlanes.Size();
+            uniquePlanes.Add(plane);
+            hashNext.Add(hashHead[key]);
+            hashHead[key] = found;
+        }
 
-    file.Read(sector.AmbientColor, 3);
-    sector.AmbientIntensity = file.ReadFloat();
-    sector.AmbientUnknown = file.ReadFloat();
+        remap[planeNum] = found;
+    }
 
-    SetDumpLog(false);
+    for (Face& face : m_Faces)
+        face.PlaneNum = remap[face.PlaneNum];
 
-    for (int i = 0; i < 24; ++i) { if (DumpByte(file) != 0) LOG("not zero\n"); }
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0xCD) LOG("not CD\n"); }
-    for (int i = 0; i < 4; ++i) { if (DumpByte(file) != 0) LOG("not zero\n"); }
+    for (BSPNode& node : m_BSPNodes)
+    {
+        if (node.Type != NT_LEAF)
+            node.PlaneNum = remap[node.PlaneNum];
+    }
 
-    file.Read(sector.IlluminationColor, 3);
-    sector.IlluminationIntensity = file.ReadFloat();
-    sector.IlluminationUnknown = file.ReadFloat();
+    uniquePlanes.ShrinkToFit();
+    m_Planes = std::move(uniquePlanes);
+}
 
-    for (int i = 0; i < 24; ++i) { if (DumpByte(file) != 0) LOG("not zero\n"); }
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0xCD) LOG("not CD\n"); }
-    for (int i = 0; i < 4; ++i) { if (DumpByte(file) != 0) LOG("not zero\n"); }
+int32_t BladeWorld::FindAtmosphere(NameAtom atom) const
+{
+    for (int32_t i = 0, count = m_Atmospheres.Size(); i < count; ++i)
+    {
+        if (m_Atmospheres[i].Atom == atom)
+            return i;
+    }
+    return -1;
+}
 
-    // Light direction?
-    sector.IlluminationVector = file.ReadObject<Double3>();
+bool BladeWorld::ScanSector(MemoryCursor& cursor, SectorLayout& layout)
+{
+    // Atmosphere name, ambient, padding, illumination, padding, illumination vector
+    cursor.ReadStringView();
+    cursor.Skip(3 + 4 + 4 + 36 + 3 + 4 + 4 + 36 + sizeof(Double3));
+
+    int32_t faceCount = cursor.ReadInt32();
+    if (!cursor.IsValid() || faceCount < 4 || faceCount > 100)
+        return false;
 
-    int32_t faceCount = file.ReadInt32();
-    if (faceCount < 4 || faceCount > 100)
+    layout.FaceCount = faceCount;
+
+    for (int32_t faceIndex = 0; faceIndex < faceCount; ++faceIndex)
     {
-        LOG("WARNING: FILE READ ERROR.. SOMETHING GO WRONG!\n");
-        HK_ASSERT(0);
+        if (!ScanFace(cursor, layout))
+            return false;
+    }
+
+    return cursor.IsValid();
+}
+
+bool BladeWorld::ScanFace(MemoryCursor& cursor, SectorLayout& layout)
+{
+    FACE_TYPE type = static_cast<FACE_TYPE>(cursor.ReadInt32());
+
+    // Every face starts with a plane
+    cursor.Skip(sizeof(PlaneD));
+    layout.PlaneCount++;
+
+    switch (type)
+    {
+        case FT_OPAQUE:
+            ScanTexInfo(cursor, layout);
+            layout.IndexCount += ScanIndices(cursor);
+            break;
+        case FT_TRANSPARENT:
+            layout.IndexCount += ScanIndices(cursor);
+            cursor.Skip(4);
+            ScanTexInfo(cursor, layout);
+            layout.PortalCount++;
+            break;
+        case FT_SINGLE_PORTAL:
+            ScanTexInfo(cursor, layout);
+            layout.IndexCount += ScanIndices(cursor);
+            layout.IndexCount += ScanIndices(cursor);
+            cursor.Skip(4);
+            layout.TangentPlaneCount += ScanTangentPlanes(cursor);
+            layout.HoleCount++;
+            layout.PortalCount++;
+            break;
+        case FT_MULTIPLE_PORTALS:
+        {
+            ScanTexInfo(cursor, layout);
+            layout.IndexCount += ScanIndices(cursor);
+
+            int32_t holeCount = cursor.ReadInt32();
+            if (holeCount < 0)
+                return false;
+            for (int32_t i = 0; i < holeCount && cursor.IsValid(); ++i)
+            {
+                layout.IndexCount += ScanIndices(cursor);
+                cursor.Skip(4);
+                layout.TangentPlaneCount += ScanTangentPlanes(cursor);
+            }
+            layout.HoleCount += holeCount;
+            layout.PortalCount += holeCount;
+
+            if (!ScanBSPNode_r(cursor, layout))
+                return false;
+            break;
+        }
+        case FT_SKYDOME:
+            layout.IndexCount += ScanIndices(cursor);
+            break;
+        default:
+            return false;
+    }
+
+    return cursor.IsValid();
+}
+
+bool BladeWorld::ScanBSPNode_r(MemoryCursor& cursor, SectorLayout& layout)
+{
+    NODE_TYPE type = static_cast<NODE_TYPE>(cursor.ReadInt32());
+    if (!cursor.IsValid())
         return false;
+
+    layout.NodeCount++;
+
+    if (type == NT_LEAF)
+    {
+        int32_t count = cursor.ReadInt32();
+        if (count < 0)
+            return false;
+        for (int32_t i = 0; i < count && cursor.IsValid(); ++i)
+        {
+            cursor.Skip(4);
+            layout.LeafIndexCount += ScanIndices(cursor);
+        }
+        layout.LeafEntryCount += count;
+        return cursor.IsValid();
     }
 
-    sector.FirstFace = m_Faces.Size();
-    sector.FaceCount = faceCount;
+    if (type != NT_NODE && type != NT_TEXINFO)
+        return false;
+
+    if (!ScanBSPNode_r(cursor, layout) || !ScanBSPNode_r(cursor, layout))
+        return false;
 
-    sector.FirstPortal = m_Portals.Size();
+    cursor.Skip(sizeof(PlaneD));
+    layout.PlaneCount++;
 
-    SetDumpLog(true);
+    if (type == NT_TEXINFO)
+        ScanTexInfo(cursor, layout);
+
+    return cursor.IsValid();
+}
+
+void BladeWorld::ScanTexInfo(MemoryCursor& cursor, SectorLayout& layout)
+{
+    // Signature
+    cursor.Skip(8);
+
+    // Texture names are resolved here, in file order, so texture numbers don't depend on the decode order
+    StringView name = cursor.ReadStringView();
+
+    NameAtom atom = NameTable::Intern(name);
+
+    int32_t textureNum;
+    auto it = m_TextureNumByAtom.Find(atom);
+    if (it != m_TextureNumByAtom.End())
+    {
+        textureNum = it->second;
+    }
+    else
+    {
+        textureNum = m_TextureNames.Size();
+        m_TextureNames.EmplaceBack(name);
+        m_TextureAtoms.Add(atom);
+        m_TextureNumByAtom[atom] = textureNum;
+    }
+    m_TextureRefs.Add(textureNum);
+
+    // Texture axes, offsets and 8 zero bytes
+    cursor.Skip(sizeof(Double3) * 2 + 4 * 2 + 8);
+}
+
+uint32_t BladeWorld::ScanIndices(MemoryCursor& cursor)
+{
+    uint32_t count = cursor.ReadUInt32();
+    if (count > cursor.GetRemaining() / sizeof(uint32_t))
+    {
+        cursor.Skip(cursor.GetRemaining() + 1);
+        return 0;
+    }
+    cursor.Skip(count * sizeof(uint32_t));
+    return count;
+}
+
+uint32_t BladeWorld::ScanTangentPlanes(MemoryCursor& cursor)
+{
+    uint32_t count = cursor.ReadUInt32();
+    if (count > cursor.GetRemaining() / sizeof(PlaneD))
+    {
+        cursor.Skip(cursor.GetRemaining() + 1);
+        return 0;
+    }
+    cursor.Skip(count * sizeof(PlaneD));
+    return count;
+}
+
+bool BladeWorld::ReadSector(SectorCursor& cursor)
+{
+    Sector& sector = m_Sectors[cursor.SectorIndex];
+
+    sector.AtmosphereNum = FindAtmosphere(NameTable::Find(cursor.ReadStringView()));
+
+    cursor.Read(sector.AmbientColor, 3);
+    sector.AmbientIntensity = cursor.ReadFloat();
+    sector.AmbientUnknown = cursor.ReadFloat();
+
+    ReadSectorPadding(cursor);
+
+    cursor.Read(sector.IlluminationColor, 3);
+    sector.IlluminationIntensity = cursor.ReadFloat();
+    sector.IlluminationUnknown = cursor.ReadFloat();
+
+    ReadSectorPadding(cursor);
+
+    // Light direction?
+    sector.IlluminationVector = cursor.ReadObject<Double3>();
+
+    // Face count was validated by the pre-scan
+    int32_t faceCount = cursor.ReadInt32();
+
+    sector.FirstFace = cursor.NextFace;
+    sector.FaceCount = faceCount;
+
+    sector.FirstPortal = cursor.NextPortal;
 
     for (int32_t faceIndex = 0; faceIndex < faceCount; ++faceIndex)
     {
-        Face& face = m_Faces.EmplaceBack();
-        face.SectorIndex = sectorIndex;
-        ReadFace(file, &face);
+        Face& face = m_Faces[cursor.NextFace++];
+        face.SectorIndex = cursor.SectorIndex;
+        ReadFace(cursor, &face);
     }
 
-    sector.PortalCount = m_Portals.Size() - sector.FirstPortal;
+    sector.PortalCount = cursor.NextPortal - sector.FirstPortal;
 
-    return true;
+    return cursor.IsValid();
 }
 
-void BladeWorld::ReadFace(File& file, Face* face)
+void BladeWorld::ReadFace(SectorCursor& cursor, Face* face)
 {
-    face->Type = static_cast<FACE_TYPE>(file.ReadInt32());
+    face->Type = static_cast<FACE_TYPE>(cursor.ReadInt32());
 
     switch (face->Type)
     {
         case FT_OPAQUE:
-            ReadOpaqueFace(file, face);
+            ReadOpaqueFace(cursor, face);
             break;
         case FT_TRANSPARENT:
-            ReadTransparentFace(file, face);
+            ReadTransparentFace(cursor, face);
             break;
         case FT_SINGLE_PORTAL:
-            ReadSinglePortalFace(file, face);
+            ReadSinglePortalFace(cursor, face);
             break;
         case FT_MULTIPLE_PORTALS:
-            ReadMultiplePortalsFace(file, face);
+            ReadMultiplePortalsFace(cursor, face);
             break;
         case FT_SKYDOME:
-            ReadSkydomeFace(file, face);
+            ReadSkydomeFace(cursor, face);
             break;
         default:
             HK_ASSERT(0);
@@ -217,213 +570,244 @@ void BladeWorld::ReadFace(File& file, Face* face)
     }
 }
 
-int32_t BladeWorld::ReadPlane(File& file)
+int32_t BladeWorld::ReadPlane(SectorCursor& cursor)
 {
-    PlaneD plane = file.ReadObject<PlaneD>();
-
-    m_Planes.Add(plane);
-    return m_Planes.Size() - 1;
+    m_Planes[cursor.NextPlane] = cursor.ReadObject<PlaneD>();
+    return cursor.NextPlane++;
 }
 
-int32_t BladeWorld::ReadTextureName(File& file)
+int32_t BladeWorld::ReadTextureName(SectorCursor& cursor)
 {
-    String name = file.ReadString();
+    // Resolved by the pre-scan
+    cursor.ReadStringView();
+    return m_TextureRefs[cursor.NextTextureRef++];
+}
 
-    for (int32_t texNum = 0; texNum < m_TextureNames.Size(); ++texNum) {
-        if (!m_TextureNames[texNum].Icmp(name))
-            return texNum;
-    }
+BladeWorld::IndexRange BladeWorld::ReadIndices(SectorCursor& cursor)
+{
+    // The count was validated by the pre-scan
+    IndexRange range;
+    range.First = cursor.NextIndex;
+    range.Count = cursor.ReadUInt32();
+
+    cursor.ReadArray(m_Indices.ToPtr() + range.First, range.Count);
+    cursor.NextIndex += range.Count;
+    return range;
+}
 
-    m_TextureNames.Add(std::move(name));
-    return m_TextureNames.Size() - 1;
+void BladeWorld::ReadSectorPadding(MemoryCursor& cursor)
+{
+    // 24 zero bytes, 8 0xCD bytes (uninitialized memory in the original exporter), 4 zero bytes
+    if (!cursor.ExpectBytes(0, 24))
+        LOG("not zero\n");
+    if (!cursor.ExpectBytes(0xCD, 8))
+        LOG("not CD\n");
+    if (!cursor.ExpectBytes(0, 4))
+        LOG("not zero\n");
 }
 
-void BladeWorld::ReadIndices(File& file, Vector<uint32_t>& indices)
+BladeWorld::IndexRange BladeWorld::ReadTangentPlanes(SectorCursor& cursor)
 {
-    indices.Resize(file.ReadInt32());
-    for (auto& index : indices)
-        index = file.ReadUInt32();
+    static_assert(sizeof(PlaneD) == sizeof(double) * 4, "Unexpected PlaneD layout");
+
+    IndexRange range;
+    range.First = cursor.NextTangentPlane;
+    range.Count = cursor.ReadUInt32();
+
+    cursor.ReadArray(m_TangentPlanes.ToPtr() + range.First, range.Count);
+    cursor.NextTangentPlane += range.Count;
+    return range;
 }
 
-void BladeWorld::ReadOpaqueFace(File& file, Face* face)
+void BladeWorld::ReadOpaqueFace(SectorCursor& cursor, Face* face)
 {
-    face->PlaneNum = ReadPlane(file);
+    face->PlaneNum = ReadPlane(cursor);
 
-    face->UnknownSignature = file.ReadUInt64();
+    face->UnknownSignature = cursor.ReadUInt64();
     if (face->UnknownSignature != 3)
         LOG("Face signature {}\n", face->UnknownSignature);
 
-    face->TextureNum = ReadTextureName(file);
-    face->TexCoordAxis[0] = file.ReadObject<Double3>();
-    face->TexCoordAxis[1] = file.ReadObject<Double3>();
-    face->TexCoordOffset[0] = file.ReadFloat();
-    face->TexCoordOffset[1] = file.ReadFloat();
+    face->TextureNum = ReadTextureName(cursor);
+    face->TexCoordAxis[0] = cursor.ReadObject<Double3>();
+    face->TexCoordAxis[1] = cursor.ReadObject<Double3>();
+    face->TexCoordOffset[0] = cursor.ReadFloat();
+    face->TexCoordOffset[1] = cursor.ReadFloat();
 
     // 8 zero bytes?
-    SetDumpLog(false);
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0) LOG("not zero!\n"); }
-    SetDumpLog(true);
+    if (!cursor.ExpectBytes(0, 8))
+        LOG("not zero!\n");
 
-    ReadIndices(file, face->Winding);
+    face->Winding = ReadIndices(cursor);
 }
 
-void BladeWorld::ReadTransparentFace(File& file, Face* face)
+void BladeWorld::ReadTransparentFace(SectorCursor& cursor, Face* face)
 {
-    face->PlaneNum = ReadPlane(file);
+    face->PlaneNum = ReadPlane(cursor);
 
-    ReadIndices(file, face->Winding);
+    face->Winding = ReadIndices(cursor);
 
-    Portal& portal = m_Portals.EmplaceBack();
+    Portal& portal = m_Portals[cursor.NextPortal++];
 
     //portal.FaceNum = face;
-    portal.ToSector = file.ReadInt32();
+    portal.ToSector = cursor.ReadInt32();
+    portal.Winding = face->Winding;
 
-    face->UnknownSignature = file.ReadUInt64();
+    face->UnknownSignature = cursor.ReadUInt64();
     if (face->UnknownSignature != 3)
         LOG("Face signature {}\n", face->UnknownSignature);
 
     // FIXME: wtf portal has texture properties? Is it doors?
 
-    face->TextureNum = ReadTextureName(file);
-    face->TexCoordAxis[0] = file.ReadObject<Double3>();
-    face->TexCoordAxis[1] = file.ReadObject<Double3>();
-    face->TexCoordOffset[0] = file.ReadFloat();
-    face->TexCoordOffset[1] = file.ReadFloat();
+    face->TextureNum = ReadTextureName(cursor);
+    face->TexCoordAxis[0] = cursor.ReadObject<Double3>();
+    face->TexCoordAxis[1] = cursor.ReadObject<Double3>();
+    face->TexCoordOffset[0] = cursor.ReadFloat();
+    face->TexCoordOffset[1] = cursor.ReadFloat();
 
     // 8 zero bytes?
-    SetDumpLog(false);
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0) LOG("not zero!\n"); }
-    SetDumpLog(true);
+    if (!cursor.ExpectBytes(0, 8))
+        LOG("not zero!\n");
 }
 
-void BladeWorld::ReadSinglePortalFace(File& file, Face* face)
+void BladeWorld::ReadSinglePortalFace(SectorCursor& cursor, Face* face)
 {
-    face->PlaneNum = ReadPlane(file);
+    face->PlaneNum = ReadPlane(cursor);
 
-    face->UnknownSignature = file.ReadUInt64();
+    face->UnknownSignature = cursor.ReadUInt64();
     if (face->UnknownSignature != 3)
         LOG("Face signature {}\n", face->UnknownSignature);
 
-    face->TextureNum = ReadTextureName(file);
-    face->TexCoordAxis[0] = file.ReadObject<Double3>();
-    face->TexCoordAxis[1] = file.ReadObject<Double3>();
-    face->TexCoordOffset[0] = file.ReadFloat();
-    face->TexCoordOffset[1] = file.ReadFloat();
+    face->TextureNum = ReadTextureName(cursor);
+    face->TexCoordAxis[0] = cursor.ReadObject<Double3>();
+    face->TexCoordAxis[1] = cursor.ReadObject<Double3>();
+    face->TexCoordOffset[0] = cursor.ReadFloat();
+    face->TexCoordOffset[1] = cursor.ReadFloat();
 
     // 8 zero bytes?
-    SetDumpLog(false);
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0) LOG("not zero!\n"); }
-    SetDumpLog(true);
+    if (!cursor.ExpectBytes(0, 8))
+        LOG("not zero!\n");
 
     // Winding
-    ReadIndices(file, face->Winding);
+    face->Winding = ReadIndices(cursor);
 
     // Winding hole
-    face->Holes.Resize(1);
-    ReadIndices(file, face->Holes[0]);
+    face->Holes.First = cursor.NextHole++;
+    face->Holes.Count = 1;
+    m_Holes[face->Holes.First] = ReadIndices(cursor);
 
-    Portal& portal = m_Portals.EmplaceBack();
+    Portal& portal = m_Portals[cursor.NextPortal++];
 
     //portal.FaceNum = face;
-    portal.ToSector = file.ReadInt32();
+    portal.ToSector = cursor.ReadInt32();
+    portal.Winding = m_Holes[face->Holes.First];
 
-    int32_t count = file.ReadInt32();
-    portal.TangentPlanes.Resize(count);
-    for (auto& tangentPlane : portal.TangentPlanes)
-        tangentPlane = file.ReadObject<PlaneD>();
+    portal.TangentPlanes = ReadTangentPlanes(cursor);
 }
 
-void BladeWorld::ReadMultiplePortalsFace(File& file, Face* face)
+void BladeWorld::ReadMultiplePortalsFace(SectorCursor& cursor, Face* face)
 {
-    face->PlaneNum = ReadPlane(file);
+    face->PlaneNum = ReadPlane(cursor);
 
-    face->UnknownSignature = file.ReadUInt64();
+    face->UnknownSignature = cursor.ReadUInt64();
     if (face->UnknownSignature != 3)
         LOG("Face signature {}\n", face->UnknownSignature);
 
-    face->TextureNum = ReadTextureName(file);
-    face->TexCoordAxis[0] = file.ReadObject<Double3>();
-    face->TexCoordAxis[1] = file.ReadObject<Double3>();
-    face->TexCoordOffset[0] = file.ReadFloat();
-    face->TexCoordOffset[1] = file.ReadFloat();
+    face->TextureNum = ReadTextureName(cursor);
+    face->TexCoordAxis[0] = cursor.ReadObject<Double3>();
+    face->TexCoordAxis[1] = cursor.ReadObject<Double3>();
+    face->TexCoordOffset[0] = cursor.ReadFloat();
+    face->TexCoordOffset[1] = cursor.ReadFloat();
 
     // 8 zero bytes?
-    SetDumpLog(false);
-    for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0) LOG("not zero!\n"); }
-    SetDumpLog(true);
+    if (!cursor.ExpectBytes(0, 8))
+        LOG("not zero!\n");
 
     // Winding
-    ReadIndices(file, face->Winding);
+    face->Winding = ReadIndices(cursor);
 
-    face->Holes.Resize(file.ReadInt32());
-    for (auto& hole : face->Holes)
+    face->Holes.First = cursor.NextHole;
+    face->Holes.Count = cursor.ReadInt32();
+    cursor.NextHole += face->Holes.Count;
+
+    for (uint32_t holeNum = 0; holeNum < face->Holes.Count; ++holeNum)
     {
-        ReadIndices(file, hole);
+        m_Holes[face->Holes.First + holeNum] = ReadIndices(cursor);
 
-        Portal& portal = m_Portals.EmplaceBack();
+        Portal& portal = m_Portals[cursor.NextPortal++];
 
         //portal.FaceNum = face;
-        portal.ToSector = file.ReadInt32();
+        portal.ToSector = cursor.ReadInt32();
+        portal.Winding = m_Holes[face->Holes.First + holeNum];
 
-        portal.TangentPlanes.Resize(file.ReadInt32());
-        for (auto& tangentPlane : portal.TangentPlanes)
-            tangentPlane = file.ReadObject<PlaneD>();
+        portal.TangentPlanes = ReadTangentPlanes(cursor);
     }
 
-    face->pRoot = ReadBSPNode_r(file, face);
+    face->RootNode = ReadBSPNode_r(cursor, face);
 }
 
-BladeWorld::BSPNode* BladeWorld::ReadBSPNode_r(File& file, Face* face)
+uint32_t BladeWorld::ReadBSPNode_r(SectorCursor& cursor, Face* face)
 {
-    BSPNode* node = m_BSPNodes.EmplaceBack(MakeUnique<BSPNode>()).RawPtr();
+    // Nodes are stored in pre-order, the same order the pre-scan counted them
+    uint32_t nodeIndex = cursor.NextNode++;
+
+    BSPNode& node = m_BSPNodes[nodeIndex];
 
-    node->Type = static_cast<NODE_TYPE>(file.ReadInt32());
+    node.Type = static_cast<NODE_TYPE>(cursor.ReadInt32());
 
-    if (node->Type == NT_LEAF)
+    if (node.Type == NT_LEAF)
     {
-        node->Children[0] = nullptr;
-        node->Children[1] = nullptr;
+        node.Children[0] = InvalidNode;
+        node.Children[1] = InvalidNode;
 
-        node->Unknown.Resize(file.ReadInt32());
-        for (LeafIndices& unknown : node->Unknown)
+        node.FirstLeafEntry = cursor.NextLeafEntry;
+        node.LeafEntryCount = cursor.ReadInt32();
+
+        cursor.NextLeafEntry += node.LeafEntryCount;
+
+        for (uint32_t i = 0; i < node.LeafEntryCount; ++i)
         {
-            unknown.UnknownIndex = file.ReadInt32();
+            LeafIndices& unknown = m_LeafEntries[node.FirstLeafEntry + i];
 
-            unknown.Indices.Resize(file.ReadInt32());
-            for (uint32_t& index : unknown.Indices)
-                index = file.ReadInt32();
+            unknown.UnknownIndex = cursor.ReadInt32();
+            unknown.IndexCount = cursor.ReadUInt32();
+            unknown.FirstIndex = cursor.NextLeafIndex;
+
+            cursor.ReadArray(m_LeafIndices.ToPtr() + unknown.FirstIndex, unknown.IndexCount);
+            cursor.NextLeafIndex += unknown.IndexCount;
         }
 
-        return node;
+        return nodeIndex;
     }
 
-    node->Children[0] = ReadBSPNode_r(file, face);
-    node->Children[1] = ReadBSPNode_r(file, face);
+    node.FirstLeafEntry = 0;
+    node.LeafEntryCount = 0;
+
+    node.Children[0] = ReadBSPNode_r(cursor, face);
+    node.Children[1] = ReadBSPNode_r(cursor, face);
 
-    node->PlaneNum = ReadPlane(file);
+    node.PlaneNum = ReadPlane(cursor);
 
-    if (node->Type == NT_TEXINFO)
+    if (node.Type == NT_TEXINFO)
     {
-        node->UnknownSignature = file.ReadUInt64();
+        node.UnknownSignature = cursor.ReadUInt64();
 
-        node->TextureNum = ReadTextureName(file);
-        node->TexCoordAxis[0] = file.ReadObject<Double3>();
-        node->TexCoordAxis[1] = file.ReadObject<Double3>();
-        node->TexCoordOffset[0] = file.ReadFloat();
-        node->TexCoordOffset[1] = file.ReadFloat();
+        node.TextureNum = ReadTextureName(cursor);
+        node.TexCoordAxis[0] = cursor.ReadObject<Double3>();
+        node.TexCoordAxis[1] = cursor.ReadObject<Double3>();
+        node.TexCoordOffset[0] = cursor.ReadFloat();
+        node.TexCoordOffset[1] = cursor.ReadFloat();
 
         // 8 zero bytes?
-        SetDumpLog(false);
-        for (int i = 0; i < 8; ++i) { if (DumpByte(file) != 0) LOG("not zero!\n"); }
-        SetDumpLog(true);
+        if (!cursor.ExpectBytes(0, 8))
+            LOG("not zero!\n");
     }
 
-    return node;
+    return nodeIndex;
 }
 
-void BladeWorld::ReadSkydomeFace(File& file, Face* face)
+void BladeWorld::ReadSkydomeFace(SectorCursor& cursor, Face* face)
 {
-    face->PlaneNum = ReadPlane(file);
+    face->PlaneNum = ReadPlane(cursor);
 
-    ReadIndices(file, face->Winding);
+    face->Winding = ReadIndices(cursor);
 }
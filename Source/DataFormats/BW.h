@@ -30,9 +30,14 @@ SOFTWARE.
 
 #include <Hork/Core/UniqueRef.h>
 #include <Hork/Core/Containers/Vector.h>
+#include <Hork/Core/Containers/ArrayView.h>
+#include <Hork/Core/Containers/Hash.h>
 #include <Hork/Math/Plane.h>
 #include <Hork/Geometry/BV/BvAxisAlignedBox.h>
 
+#include "../Utils/MemoryCursor.h"
+#include "../Utils/NameTable.h"
+
 using namespace Hk;
 
 class BladeWorld
@@ -63,21 +68,33 @@ public:
     struct AtmosphereEntry
     {
         String              Name;
+        NameAtom            Atom;
         byte                Color[3];
         float               Opacity;
     };
 
+    static constexpr uint32_t InvalidNode = ~0u;
+
+    // Range of a shared array
+    struct IndexRange
+    {
+        uint32_t            First = 0;
+        uint32_t            Count = 0;
+    };
+
+    // Index list of a leaf. Indices are stored in m_LeafIndices.
     struct LeafIndices
     {
         uint32_t            UnknownIndex;
-        Vector<uint32_t>    Indices;
+        uint32_t            FirstIndex;
+        uint32_t            IndexCount;
     };
 
     struct BSPNode
     {
         NODE_TYPE           Type;
 
-        BSPNode*            Children[2];  // nullptr for leafs
+        uint32_t            Children[2];  // Indices in m_BSPNodes, InvalidNode for leafs
 
         // Only for nodes
         int32_t             PlaneNum;
@@ -88,8 +105,9 @@ public:
         Double3             TexCoordAxis[2];
         float               TexCoordOffset[2];
 
-        // Only for leafs
-        Vector<LeafIndices> Unknown;
+        // Only for leafs. Range in m_LeafEntries.
+        uint32_t            FirstLeafEntry;
+        uint32_t            LeafEntryCount;
     };
 
     struct Face
@@ -101,19 +119,20 @@ public:
         Double3             TexCoordAxis[2];
         float               TexCoordOffset[2];
 
-        Vector<uint32_t>            Winding;
-        Vector<Vector<uint32_t>>    Holes;
+        IndexRange          Winding;    // Range in m_Indices
+        IndexRange          Holes;      // Range in m_Holes
 
         int32_t             SectorIndex;
 
-        BSPNode*            pRoot = nullptr;
+        uint32_t            RootNode = InvalidNode;
     };
 
     struct Portal
     {
         //int32_t           FaceNum;
         int32_t             ToSector;
-        Vector<PlaneD>      TangentPlanes;
+        IndexRange          Winding;        // Opening between the sectors. Range in m_Indices.
+        IndexRange          TangentPlanes;  // Range in m_TangentPlanes
     };
 
     struct Sector
@@ -161,18 +180,95 @@ public:
 
     void                    Clear();
 
+    ArrayView<const uint32_t> GetWinding(Face const& face) const
+    {
+        return ArrayView<const uint32_t>(m_Indices.ToPtr() + face.Winding.First, face.Winding.Count);
+    }
+
+    ArrayView<const uint32_t> GetHole(Face const& face, uint32_t holeNum) const
+    {
+        HK_ASSERT(holeNum < face.Holes.Count);
+        IndexRange const& hole = m_Holes[face.Holes.First + holeNum];
+        return ArrayView<const uint32_t>(m_Indices.ToPtr() + hole.First, hole.Count);
+    }
+
+    ArrayView<const PlaneD> GetTangentPlanes(Portal const& portal) const
+    {
+        return ArrayView<const PlaneD>(m_TangentPlanes.ToPtr() + portal.TangentPlanes.First, portal.TangentPlanes.Count);
+    }
+
 private:
-    bool                    ReadSector(File& file, uint32_t sectorIndex);
-    void                    ReadFace(File& file, Face* face);
-    void                    ReadOpaqueFace(File& file, Face* face);
-    void                    ReadTransparentFace(File& file, Face* face);
-    void                    ReadSinglePortalFace(File& file, Face* face);
-    void                    ReadMultiplePortalsFace(File& file, Face* face);
-    void                    ReadSkydomeFace(File& file, Face* face);
-    BSPNode*                ReadBSPNode_r(File& file, Face* face);
-    int32_t                 ReadPlane(File& file);
-    int32_t                 ReadTextureName(File& file);
-    void                    ReadIndices(File& file, Vector<uint32_t>& indices);
+    // Byte range and output ranges of a sector, found by the pre-scan so sectors can be decoded in parallel.
+    struct SectorLayout
+    {
+        size_t              Offset;
+        uint32_t            FaceCount;
+        uint32_t            FirstFace;
+        uint32_t            FirstPortal;
+        uint32_t            PortalCount;
+        uint32_t            FirstNode;
+        uint32_t            NodeCount;
+        uint32_t            FirstPlane;
+        uint32_t            PlaneCount;
+        uint32_t            FirstTextureRef;
+        uint32_t            FirstLeafEntry;
+        uint32_t            LeafEntryCount;
+        uint32_t            FirstLeafIndex;
+        uint32_t            LeafIndexCount;
+        uint32_t            FirstIndex;
+        uint32_t            IndexCount;
+        uint32_t            FirstHole;
+        uint32_t            HoleCount;
+        uint32_t            FirstTangentPlane;
+        uint32_t            TangentPlaneCount;
+    };
+
+    // Cursor over one sector. Output is written to the ranges reserved for the sector.
+    struct SectorCursor : MemoryCursor
+    {
+        using MemoryCursor::MemoryCursor;
+
+        uint32_t            SectorIndex;
+        uint32_t            NextFace;
+        uint32_t            NextPortal;
+        uint32_t            NextNode;
+        uint32_t            NextPlane;
+        uint32_t            NextTextureRef;
+        uint32_t            NextLeafEntry;
+        uint32_t            NextLeafIndex;
+        uint32_t            NextIndex;
+        uint32_t            NextHole;
+        uint32_t            NextTangentPlane;
+    };
+
+    bool                    ScanSector(MemoryCursor& cursor, SectorLayout& layout);
+    bool                    ScanFace(MemoryCursor& cursor, SectorLayout& layout);
+    bool                    ScanBSPNode_r(MemoryCursor& cursor, SectorLayout& layout);
+    void                    ScanTexInfo(MemoryCursor& cursor, SectorLayout& layout);
+    uint32_t                ScanIndices(MemoryCursor& cursor);
+    uint32_t                ScanTangentPlanes(MemoryCursor& cursor);
+
+    bool                    ReadSector(SectorCursor& cursor);
+    void                    ReadFace(SectorCursor& cursor, Face* face);
+    void                    ReadOpaqueFace(SectorCursor& cursor, Face* face);
+    void                    ReadTransparentFace(SectorCursor& cursor, Face* face);
+    void                    ReadSinglePortalFace(SectorCursor& cursor, Face* face);
+    void                    ReadMultiplePortalsFace(SectorCursor& cursor, Face* face);
+    void                    ReadSkydomeFace(SectorCursor& cursor, Face* face);
+    uint32_t                ReadBSPNode_r(SectorCursor& cursor, Face* face);
+    int32_t                 ReadPlane(SectorCursor& cursor);
+    int32_t                 ReadTextureName(SectorCursor& cursor);
+    IndexRange              ReadIndices(SectorCursor& cursor);
+    IndexRange              ReadTangentPlanes(SectorCursor& cursor);
+    void                    ReadSectorPadding(MemoryCursor& cursor);
+    int32_t                 FindAtmosphere(NameAtom atom) const;
+    void                    DeduplicatePlanes();
+
+    // Texture number of every texture name in file order, resolved by the pre-scan
+    Vector<int32_t>         m_TextureRefs;
+
+    // Texture number by name atom, used by the pre-scan
+    HashMap<NameAtom, int32_t>  m_TextureNumByAtom;
 
 public:
     Vector<AtmosphereEntry>     m_Atmospheres;
@@ -180,8 +276,14 @@ public:
     Vector<Sector>              m_Sectors;
     Vector<Face>                m_Faces;
     Vector<Portal>              m_Portals;
-    Vector<UniqueRef<BSPNode>>  m_BSPNodes;
+    Vector<BSPNode>             m_BSPNodes;
+    Vector<LeafIndices>         m_LeafEntries;
+    Vector<uint32_t>            m_LeafIndices;
+    Vector<uint32_t>            m_Indices;          // Face windings and holes
+    Vector<IndexRange>          m_Holes;
+    Vector<PlaneD>              m_TangentPlanes;
     Vector<PlaneD>              m_Planes;
     Vector<String>              m_TextureNames;
+    Vector<NameAtom>            m_TextureAtoms;     // Interned m_TextureNames
     Vector<Light>               m_Lights;
 };
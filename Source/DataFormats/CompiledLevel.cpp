@@ -0,0 +1,308 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "CompiledLevel.h"
+#include "../Utils/Hash.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/MemoryCursor.h"
+
+#include <cmath>
+
+using namespace Hk;
+
+namespace
+{
+    constexpr uint32_t FileMagic = 'B' | ('W' << 8) | ('C' << 16) | ('L' << 24);
+
+    // Vertex as it is stored in the file. Tangents are not stored, the level compiler doesn't make them.
+    // Positions and texcoords stay in full precision, so cached geometry meets its neighbours exactly as compiled.
+    struct PackedVertex
+    {
+        float               Position[3];
+        int16_t             Normal[2];      // Octahedral
+        float               TexCoord[2];
+    };
+
+    static_assert(sizeof(PackedVertex) == 24, "Unexpected packed vertex size");
+
+    void EncodeOctahedral(Float3 const& normal, int16_t out[2])
+    {
+        float length = Math::Abs(normal.X) + Math::Abs(normal.Y) + Math::Abs(normal.Z);
+        float u = length > 0 ? normal.X / length : 0;
+        float v = length > 0 ? normal.Y / length : 0;
+        if (normal.Z < 0)
+        {
+            float foldedU = (1 - Math::Abs(v)) * (u >= 0 ? 1 : -1);
+            float foldedV = (1 - Math::Abs(u)) * (v >= 0 ? 1 : -1);
+            u = foldedU;
+            v = foldedV;
+        }
+        out[0] = int16_t(std::lround(Math::Clamp(u, -1.0f, 1.0f) * 32767));
+        out[1] = int16_t(std::lround(Math::Clamp(v, -1.0f, 1.0f) * 32767));
+    }
+
+    Float3 DecodeOctahedral(const int16_t in[2])
+    {
+        Float3 normal(in[0] / 32767.0f, in[1] / 32767.0f, 0);
+        normal.Z = 1 - Math::Abs(normal.X) - Math::Abs(normal.Y);
+        if (normal.Z < 0)
+        {
+            float unfoldedX = (1 - Math::Abs(normal.Y)) * (normal.X >= 0 ? 1 : -1);
+            normal.Y = (1 - Math::Abs(normal.X)) * (normal.Y >= 0 ? 1 : -1);
+            normal.X = unfoldedX;
+        }
+        return normal.Normalized();
+    }
+
+    void PackVertices(const MeshVertex* vertices, size_t count, PackedVertex* packed)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            MeshVertex const& v = vertices[i];
+            PackedVertex& p = packed[i];
+
+            for (int axis = 0; axis < 3; ++axis)
+                p.Position[axis] = v.Position[axis];
+
+            EncodeOctahedral(v.GetNormal(), p.Normal);
+
+            Float2 texCoord = v.GetTexCoord();
+            p.TexCoord[0] = texCoord.X;
+            p.TexCoord[1] = texCoord.Y;
+        }
+    }
+
+    void UnpackVertices(const PackedVertex* packed, size_t count, MeshVertex* vertices)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            PackedVertex p;
+            std::memcpy(&p, packed + i, sizeof(p));
+
+            MeshVertex& v = vertices[i];
+            v = {};
+            for (int axis = 0; axis < 3; ++axis)
+                v.Position[axis] = p.Position[axis];
+            v.SetNormal(DecodeOctahedral(p.Normal));
+            v.SetTexCoord(Float2(p.TexCoord[0], p.TexCoord[1]));
+        }
+    }
+
+    bool ReadBatch(MemoryCursor& cursor, CompiledLevel::Batch& batch, size_t vertexCount, size_t indexCount)
+    {
+        batch.TextureName = cursor.ReadStringView();
+        batch.Sector = cursor.ReadInt32();
+        batch.Bounds.Mins = cursor.ReadObject<Float3>();
+        batch.Bounds.Maxs = cursor.ReadObject<Float3>();
+        batch.FirstVertex = cursor.ReadUInt32();
+        batch.VertexCount = cursor.ReadUInt32();
+        batch.FirstIndex = cursor.ReadUInt32();
+        batch.IndexCount = cursor.ReadUInt32();
+
+        return cursor.IsValid() &&
+            size_t(batch.FirstVertex) + batch.VertexCount <= vertexCount &&
+            size_t(batch.FirstIndex) + batch.IndexCount <= indexCount;
+    }
+
+    bool ReadSectors(MemoryCursor& cursor, CompiledLevel& level)
+    {
+        level.Sectors.Resize(cursor.ReadUInt32());
+        level.SectorPlanes.Resize(cursor.ReadUInt32());
+        level.Portals.Resize(cursor.ReadUInt32());
+        level.PortalVertices.Resize(cursor.ReadUInt32());
+        level.PvsData.Resize(cursor.ReadUInt32());
+        if (!cursor.ReadArray(level.Sectors.ToPtr(), level.Sectors.Size()) ||
+            !cursor.ReadArray(level.SectorPlanes.ToPtr(), level.SectorPlanes.Size()) ||
+            !cursor.ReadArray(level.Portals.ToPtr(), level.Portals.Size()) ||
+            !cursor.ReadArray(level.PortalVertices.ToPtr(), level.PortalVertices.Size()) ||
+            !cursor.ReadArray(level.PvsData.ToPtr(), level.PvsData.Size()))
+            return false;
+
+        for (auto const& sector : level.Sectors)
+        {
+            if (size_t(sector.FirstPlane) + sector.PlaneCount > level.SectorPlanes.Size() ||
+                size_t(sector.FirstPortal) + sector.PortalCount > level.Portals.Size() ||
+                size_t(sector.FirstPvsByte) + sector.PvsByteCount > level.PvsData.Size())
+                return false;
+        }
+        for (auto const& portal : level.Portals)
+        {
+            if (portal.ToSector < 0 || portal.ToSector >= int32_t(level.Sectors.Size()) ||
+                size_t(portal.FirstVertex) + portal.VertexCount > level.PortalVertices.Size())
+                return false;
+        }
+        return true;
+    }
+
+    void WriteBatch(File& file, CompiledLevel::Batch const& batch)
+    {
+        file.WriteString(batch.TextureName);
+        file.WriteInt32(batch.Sector);
+        file.WriteObject(batch.Bounds.Mins);
+        file.WriteObject(batch.Bounds.Maxs);
+        file.WriteUInt32(batch.FirstVertex);
+        file.WriteUInt32(batch.VertexCount);
+        file.WriteUInt32(batch.FirstIndex);
+        file.WriteUInt32(batch.IndexCount);
+    }
+}
+
+void CompiledLevel::Clear()
+{
+    Batches.Clear();
+    Skydome = {};
+    ShadowCasters.Clear();
+    Vertices.Clear();
+    Indices.Clear();
+    Sectors.Clear();
+    SectorPlanes.Clear();
+    Portals.Clear();
+    PortalVertices.Clear();
+    PvsData.Clear();
+}
+
+void CompiledLevel::FillBatch(Batch& batch, StringView textureName, int32_t sector, Vector<MeshVertex> const& vertices, Vector<uint32_t> const& indices)
+{
+    batch.TextureName = textureName;
+    batch.Sector = sector;
+    batch.FirstVertex = Vertices.Size();
+    batch.VertexCount = vertices.Size();
+    batch.FirstIndex = Indices.Size();
+    batch.IndexCount = indices.Size();
+
+    batch.Bounds.Clear();
+    for (auto& v : vertices)
+        batch.Bounds.AddPoint(v.Position);
+
+    Vertices.Add(vertices);
+    Indices.Add(indices);
+}
+
+bool CompiledLevel::Load(StringView fileName, uint64_t sourceHash)
+{
+    Clear();
+
+    MappedFile file;
+    if (!file.Open(fileName))
+        return false;
+
+    MemoryCursor cursor(file.GetData(), file.GetSize());
+
+    if (cursor.ReadUInt32() != FileMagic ||
+        cursor.ReadUInt32() != Version ||
+        cursor.ReadUInt64() != sourceHash ||
+        cursor.ReadUInt32() != sizeof(PackedVertex))
+        return false;
+
+    // Geometry goes first, so batch ranges can be validated as they are read.
+    // Vertices are unpacked once the batches are known, straight from the mapped file.
+    Vertices.Resize(cursor.ReadUInt32());
+    Indices.Resize(cursor.ReadUInt32());
+    const PackedVertex* packedVertices = reinterpret_cast<const PackedVertex*>(cursor.Skip(size_t(Vertices.Size()) * sizeof(PackedVertex)));
+    if (!packedVertices ||
+        !cursor.ReadArray(Indices.ToPtr(), Indices.Size()))
+    {
+        Clear();
+        return false;
+    }
+
+    Batches.Resize(cursor.ReadUInt32());
+    if (!cursor.IsValid())
+    {
+        Clear();
+        return false;
+    }
+
+    bool valid = true;
+    for (auto& batch : Batches)
+        valid = valid && ReadBatch(cursor, batch, Vertices.Size(), Indices.Size());
+    valid = valid && ReadBatch(cursor, Skydome, Vertices.Size(), Indices.Size());
+    ShadowCasters.Resize(valid ? cursor.ReadUInt32() : 0);
+    valid = valid && cursor.IsValid();
+    for (auto& batch : ShadowCasters)
+        valid = valid && ReadBatch(cursor, batch, Vertices.Size(), Indices.Size());
+    valid = valid && ReadSectors(cursor, *this);
+
+    for (auto const& batch : Batches)
+        valid = valid && batch.Sector < int32_t(Sectors.Size());
+
+    if (!valid)
+    {
+        LOG("CompiledLevel::Load: Damaged file {}\n", fileName);
+        Clear();
+        return false;
+    }
+
+    UnpackVertices(packedVertices, Vertices.Size(), Vertices.ToPtr());
+    return true;
+}
+
+bool CompiledLevel::Save(StringView fileName, uint64_t sourceHash) const
+{
+    File file = File::sOpenWrite(fileName);
+    if (!file)
+        return false;
+
+    file.WriteUInt32(FileMagic);
+    file.WriteUInt32(Version);
+    file.WriteUInt64(sourceHash);
+    file.WriteUInt32(sizeof(PackedVertex));
+
+    Vector<PackedVertex> packedVertices(Vertices.Size());
+    PackVertices(Vertices.ToPtr(), Vertices.Size(), packedVertices.ToPtr());
+
+    file.WriteUInt32(Vertices.Size());
+    file.WriteUInt32(Indices.Size());
+    file.Write(packedVertices.ToPtr(), packedVertices.Size() * sizeof(PackedVertex));
+    file.Write(Indices.ToPtr(), Indices.Size() * sizeof(uint32_t));
+
+    file.WriteUInt32(Batches.Size());
+    for (auto const& batch : Batches)
+        WriteBatch(file, batch);
+    WriteBatch(file, Skydome);
+    file.WriteUInt32(ShadowCasters.Size());
+    for (auto const& batch : ShadowCasters)
+        WriteBatch(file, batch);
+
+    file.WriteUInt32(Sectors.Size());
+    file.WriteUInt32(SectorPlanes.Size());
+    file.WriteUInt32(Portals.Size());
+    file.WriteUInt32(PortalVertices.Size());
+    file.WriteUInt32(PvsData.Size());
+    file.Write(Sectors.ToPtr(), Sectors.Size() * sizeof(Sector));
+    file.Write(SectorPlanes.ToPtr(), SectorPlanes.Size() * sizeof(PlaneF));
+    file.Write(Portals.ToPtr(), Portals.Size() * sizeof(Portal));
+    file.Write(PortalVertices.ToPtr(), PortalVertices.Size() * sizeof(Float3));
+    file.Write(PvsData.ToPtr(), PvsData.Size());
+    return true;
+}
+
+uint64_t CompiledLevel::sHashSource(const void* data, size_t size)
+{
+    return HashFNV1a(data, size);
+}
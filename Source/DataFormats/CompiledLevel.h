@@ -0,0 +1,112 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/String.h>
+#include <Hork/Core/Containers/Vector.h>
+#include <Hork/Geometry/BV/BvAxisAlignedBox.h>
+#include <Hork/Math/Plane.h>
+#include <Hork/Geometry/VertexFormat.h>
+
+using namespace Hk;
+
+// Level geometry after clipping, triangulation and batching, ready to be uploaded.
+// It is saved to a cache file (.bwc), so the next load of the same map can skip the level compiler.
+class CompiledLevel
+{
+public:
+    // Increment whenever the file layout or the output of the level compiler changes
+    static constexpr uint32_t Version = 10;
+
+    struct Batch
+    {
+        String              TextureName;
+        int32_t             Sector;         // -1 if the batch is not bound to a sector
+        BvAxisAlignedBox    Bounds;
+        uint32_t            FirstVertex;
+        uint32_t            VertexCount;
+        uint32_t            FirstIndex;
+        uint32_t            IndexCount;
+    };
+
+    // Convex sector of the level. Sector planes face inside.
+    struct Sector
+    {
+        BvAxisAlignedBox    Bounds;
+        uint32_t            FirstPlane;
+        uint32_t            PlaneCount;
+        uint32_t            FirstPortal;
+        uint32_t            PortalCount;
+        uint32_t            FirstPvsByte;   // Range in PvsData
+        uint32_t            PvsByteCount;
+    };
+
+    // Opening that leads from one sector to another
+    struct Portal
+    {
+        int32_t             ToSector;
+        uint32_t            FirstVertex;    // Range in PortalVertices
+        uint32_t            VertexCount;
+    };
+
+    // Opaque geometry, one batch per sector, texture and level grid cell
+    Vector<Batch>           Batches;
+    Batch                   Skydome;
+
+    // Shadow caster geometry with only positions filled in, one batch per level region
+    Vector<Batch>           ShadowCasters;
+
+    // Geometry of all batches. Indices are relative to the first vertex of their batch.
+    // The file keeps vertices packed: octahedral normals and no tangents, positions and texcoords as they are. This only
+    // makes the cache file smaller, the vertices are unpacked to MeshVertex on load.
+    Vector<MeshVertex>      Vertices;
+    Vector<uint32_t>        Indices;
+
+    // Sector graph for the runtime portal culling
+    Vector<Sector>          Sectors;
+    Vector<PlaneF>          SectorPlanes;
+    Vector<Portal>          Portals;
+    Vector<Float3>          PortalVertices;
+
+    // Compressed bitsets of sectors potentially visible from each sector (see SectorPVS)
+    Vector<uint8_t>         PvsData;
+
+    void                    Clear();
+
+    // Copies the geometry to the shared arrays and calculates the batch bounds
+    void                    FillBatch(Batch& batch, StringView textureName, int32_t sector, Vector<MeshVertex> const& vertices, Vector<uint32_t> const& indices);
+
+    // Fails if the file is damaged or was written by another version or for another source
+    bool                    Load(StringView fileName, uint64_t sourceHash);
+
+    bool                    Save(StringView fileName, uint64_t sourceHash) const;
+
+    // Hash of the source .bw contents (64-bit FNV-1a)
+    static uint64_t         sHashSource(const void* data, size_t size);
+};
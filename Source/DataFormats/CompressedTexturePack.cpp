@@ -0,0 +1,161 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "CompressedTexturePack.h"
+#include "../Utils/BlockCompression.h"
+#include "../Utils/Hash.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/MemoryCursor.h"
+
+using namespace Hk;
+
+namespace
+{
+    constexpr uint32_t FileMagic = 'B' | ('T' << 8) | ('C' << 16) | ('P' << 24);
+
+    constexpr size_t HeaderSize = sizeof(uint32_t) * 4 + sizeof(uint64_t);
+}
+
+bool CompressedTexturePack::Load(StringView fileName, uint64_t packHash)
+{
+    Textures.Clear();
+
+    MappedFile file;
+    if (!file.Open(fileName))
+        return false;
+
+    MemoryCursor cursor(file.GetData(), file.GetSize());
+
+    if (cursor.ReadUInt32() != FileMagic ||
+        cursor.ReadUInt32() != Version ||
+        cursor.ReadUInt64() != packHash ||
+        cursor.ReadUInt32() != sizeof(Texture))
+        return false;
+
+    Textures.Resize(cursor.ReadUInt32());
+    if (!cursor.ReadArray(Textures.ToPtr(), Textures.Size()))
+    {
+        LOG("CompressedTexturePack::Load: Damaged file {}\n", fileName);
+        Textures.Clear();
+        return false;
+    }
+
+    for (auto const& texture : Textures)
+    {
+        if (texture.Width <= 0 || texture.Height <= 0 ||
+            (texture.MipCount != 0 && texture.MipCount != BlockCompression::GetMipCount(texture.Width, texture.Height)) ||
+            (texture.DataSize != 0 && (texture.MipCount == 0 ||
+                texture.DataSize != BlockCompression::GetBC1MipChainSize(texture.Width, texture.Height) ||
+                texture.DataOffset > file.GetSize() || texture.DataSize > file.GetSize() - texture.DataOffset)))
+        {
+            LOG("CompressedTexturePack::Load: Damaged file {}\n", fileName);
+            Textures.Clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompressedTexturePack::Save(StringView fileName, uint64_t packHash, Vector<HeapBlob> const& blocks)
+{
+    HK_ASSERT(blocks.Size() == Textures.Size());
+
+    File file = File::sOpenWrite(fileName);
+    if (!file)
+        return false;
+
+    uint64_t dataOffset = HeaderSize + sizeof(Texture) * Textures.Size();
+    for (uint32_t i = 0; i < Textures.Size(); ++i)
+    {
+        Textures[i].DataOffset = dataOffset;
+        Textures[i].DataSize = blocks[i].Size();
+        dataOffset += blocks[i].Size();
+    }
+
+    file.WriteUInt32(FileMagic);
+    file.WriteUInt32(Version);
+    file.WriteUInt64(packHash);
+    file.WriteUInt32(sizeof(Texture));
+    file.WriteUInt32(Textures.Size());
+    file.Write(Textures.ToPtr(), Textures.Size() * sizeof(Texture));
+
+    for (auto const& textureBlocks : blocks)
+        file.Write(textureBlocks.GetData(), textureBlocks.Size());
+    return true;
+}
+
+CompressedTexturePack::Texture CompressedTexturePack::sLeaveOut(BladeMMP::TextureHeader const& header)
+{
+    Texture texture;
+    texture.Checksum = header.Checksum;
+    texture.Width = header.Width;
+    texture.Height = header.Height;
+    texture.MipCount = 0;
+    texture.DataOffset = 0;
+    texture.DataSize = 0;
+    return texture;
+}
+
+HeapBlob CompressedTexturePack::sCompress(BladeMMP::TextureHeader const& header, const void* data, Texture& texture)
+{
+    texture = sLeaveOut(header);
+    texture.MipCount = BlockCompression::GetMipCount(header.Width, header.Height);
+
+    HeapBlob rgba;
+    rgba.Reset(size_t(header.Width) * header.Height * 4);
+    if (!BladeMMP::Decode(header, data, rgba.GetData()))
+        return {};
+
+    HeapBlob blocks;
+    blocks.Reset(BlockCompression::GetBC1MipChainSize(header.Width, header.Height));
+    BlockCompression::CompressBC1MipChain(static_cast<const uint8_t*>(rgba.GetData()), header.Width, header.Height, static_cast<uint8_t*>(blocks.GetData()));
+
+    texture.DataSize = blocks.Size();
+    return blocks;
+}
+
+uint64_t CompressedTexturePack::sHashPack(Vector<BladeMMP::TextureHeader> const& headers)
+{
+    uint64_t hash = FNV1aOffsetBasis;
+    auto hashBytes = [&hash](const void* data, size_t size)
+    {
+        hash = HashFNV1a(data, size, hash);
+    };
+
+    for (auto const& header : headers)
+    {
+        uint64_t dataSize = header.DataSize;
+        hashBytes(header.Name.CStr(), header.Name.Size());
+        hashBytes(&header.Checksum, sizeof(header.Checksum));
+        hashBytes(&header.Type, sizeof(header.Type));
+        hashBytes(&header.Width, sizeof(header.Width));
+        hashBytes(&header.Height, sizeof(header.Height));
+        hashBytes(&dataSize, sizeof(dataSize));
+    }
+    return hash;
+}
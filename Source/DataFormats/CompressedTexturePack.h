@@ -0,0 +1,77 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/String.h>
+#include <Hork/Core/Containers/Vector.h>
+
+#include "MMP.h"
+
+using namespace Hk;
+
+// Textures of an MMP pack compressed to BC1 with a full mip chain.
+// It is saved to a cache file (.btc), so the next start can upload the blocks without decoding and mipmapping.
+class CompressedTexturePack
+{
+public:
+    // Increment whenever the file layout or the output of the encoder changes
+    static constexpr uint32_t Version = 1;
+
+    // Texture in the same order as in the pack. A texture without blocks has DataSize 0 and is read from the pack.
+    // MipCount is 0 if it was left out, or the full count if its data couldn't be decoded.
+    struct Texture
+    {
+        uint32_t            Checksum;
+        int32_t             Width;
+        int32_t             Height;
+        uint32_t            MipCount;
+
+        // Blocks of all mips from the largest one, relative to the beginning of the file
+        uint64_t            DataOffset;
+        uint64_t            DataSize;
+    };
+
+    Vector<Texture>         Textures;
+
+    // Reads the texture directory only, the blocks are mapped by the loader when they are needed.
+    // Fails if the file is damaged or was written by another version or for another pack.
+    bool                    Load(StringView fileName, uint64_t packHash);
+
+    // Writes the directory and the blocks of each texture. The data offsets are filled in.
+    bool                    Save(StringView fileName, uint64_t packHash, Vector<HeapBlob> const& blocks);
+
+    // Directory entry of a texture that is left out of the cache
+    static Texture          sLeaveOut(BladeMMP::TextureHeader const& header);
+
+    // Compresses a texture of the pack. Returns an empty blob if the texture data can't be decoded.
+    static HeapBlob         sCompress(BladeMMP::TextureHeader const& header, const void* data, Texture& texture);
+
+    // Hash of the texture headers of the pack (64-bit FNV-1a). The MMP checksums cover the texture data.
+    static uint64_t         sHashPack(Vector<BladeMMP::TextureHeader> const& headers);
+};
@@ -0,0 +1,438 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "MMP.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MMP_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define MMP_TARGET(features)
+#else
+#define MMP_TARGET(features) __attribute__((target(features)))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MMP_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Hk;
+
+bool BladeMMP::ReadHeader(File& file, TextureHeader& header)
+{
+    header.Unknown = file.ReadInt16();
+    header.Checksum = file.ReadUInt32();
+
+    int32_t size = file.ReadInt32();
+
+    header.Name = file.ReadString();
+    header.Atom = NameTable::Intern(header.Name);
+    header.Type = static_cast<TEXTURE_TYPE>(file.ReadInt32());
+    header.Width = file.ReadInt32();
+    header.Height = file.ReadInt32();
+
+    // Size includes type, width and height
+    if (size < 12 || header.Width <= 0 || header.Height <= 0)
+        return false;
+
+    header.DataOffset = file.GetOffset();
+    header.DataSize = size - 12;
+    return true;
+}
+
+namespace
+{
+    // Palette entries are 6-bit, the table holds them expanded to RGBA8 in memory order
+    void MakePaletteTable(const uint8_t* palette, uint32_t table[256])
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            uint8_t rgba[4] = {uint8_t(palette[i * 3] << 2), uint8_t(palette[i * 3 + 1] << 2), uint8_t(palette[i * 3 + 2] << 2), 255};
+            std::memcpy(&table[i], rgba, 4);
+        }
+    }
+
+    void ExpandPaletteTable(const uint8_t* indices, const uint32_t table[256], size_t first, size_t count, uint8_t* rgba)
+    {
+        for (size_t k = first; k < count; ++k)
+            std::memcpy(rgba + k * 4, &table[indices[k]], 4);
+    }
+
+    void ExpandGrayscaleScalar(const uint8_t* src, size_t first, size_t count, uint8_t* rgba)
+    {
+        for (size_t k = first; k < count; ++k)
+        {
+            rgba[k * 4    ] = src[k];
+            rgba[k * 4 + 1] = src[k];
+            rgba[k * 4 + 2] = src[k];
+            rgba[k * 4 + 3] = 255;
+        }
+    }
+
+    void ExpandRGBScalar(const uint8_t* src, size_t first, size_t count, uint8_t* rgba)
+    {
+        for (size_t k = first; k < count; ++k)
+        {
+            rgba[k * 4    ] = src[k * 3    ];
+            rgba[k * 4 + 1] = src[k * 3 + 1];
+            rgba[k * 4 + 2] = src[k * 3 + 2];
+            rgba[k * 4 + 3] = 255;
+        }
+    }
+
+#ifdef MMP_X86
+    MMP_TARGET("ssse3")
+    void ExpandGrayscaleSSE(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        const __m128i alpha = _mm_set1_epi8(char(0xff));
+
+        size_t k = 0;
+        for (; k + 16 <= count; k += 16)
+        {
+            __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k));
+
+            __m128i gg0 = _mm_unpacklo_epi8(gray, gray);
+            __m128i gg1 = _mm_unpackhi_epi8(gray, gray);
+            __m128i ga0 = _mm_unpacklo_epi8(gray, alpha);
+            __m128i ga1 = _mm_unpackhi_epi8(gray, alpha);
+
+            __m128i* dst = reinterpret_cast<__m128i*>(rgba + k * 4);
+            _mm_storeu_si128(dst,     _mm_unpacklo_epi16(gg0, ga0));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(gg0, ga0));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(gg1, ga1));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(gg1, ga1));
+        }
+        ExpandGrayscaleScalar(src, k, count, rgba);
+    }
+
+    MMP_TARGET("ssse3")
+    void ExpandRGBSSE(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+
+        // Each load reads 16 bytes for 12 bytes of pixels, so the loop stops before it could read past the source
+        size_t k = 0;
+        for (; k + 6 <= count; k += 4)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + k * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+        }
+        ExpandRGBScalar(src, k, count, rgba);
+    }
+
+    MMP_TARGET("avx2")
+    void ExpandPaletteAVX2(const uint8_t* indices, const uint32_t table[256], size_t count, uint8_t* rgba)
+    {
+        size_t k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + k)));
+            __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + k * 4), pixels);
+        }
+        ExpandPaletteTable(indices, table, k, count, rgba);
+    }
+
+    MMP_TARGET("avx2")
+    void ExpandGrayscaleAVX2(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        const __m256i spread = _mm256_set1_epi32(0x010101);
+        const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+
+        size_t k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            __m256i gray = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + k)));
+            __m256i pixels = _mm256_or_si256(_mm256_mullo_epi32(gray, spread), alpha);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + k * 4), pixels);
+        }
+        ExpandGrayscaleScalar(src, k, count, rgba);
+    }
+
+    MMP_TARGET("avx2")
+    void ExpandRGBAVX2(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        // The shuffle works within 128-bit lanes, so each lane gets four pixels of its own
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+
+        size_t k = 0;
+        for (; k + 10 <= count; k += 8)
+        {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * 3));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k * 3 + 12));
+            __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + k * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+        }
+        ExpandRGBScalar(src, k, count, rgba);
+    }
+
+    bool HasSSSE3()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    bool HasAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+#ifdef MMP_NEON
+    void ExpandGrayscaleNEON(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        size_t k = 0;
+        for (; k + 16 <= count; k += 16)
+        {
+            uint8x16x4_t pixels;
+            pixels.val[0] = vld1q_u8(src + k);
+            pixels.val[1] = pixels.val[0];
+            pixels.val[2] = pixels.val[0];
+            pixels.val[3] = vdupq_n_u8(255);
+            vst4q_u8(rgba + k * 4, pixels);
+        }
+        ExpandGrayscaleScalar(src, k, count, rgba);
+    }
+
+    void ExpandRGBNEON(const uint8_t* src, size_t count, uint8_t* rgba)
+    {
+        size_t k = 0;
+        for (; k + 16 <= count; k += 16)
+        {
+            uint8x16x3_t rgb = vld3q_u8(src + k * 3);
+            uint8x16x4_t pixels;
+            pixels.val[0] = rgb.val[0];
+            pixels.val[1] = rgb.val[1];
+            pixels.val[2] = rgb.val[2];
+            pixels.val[3] = vdupq_n_u8(255);
+            vst4q_u8(rgba + k * 4, pixels);
+        }
+        ExpandRGBScalar(src, k, count, rgba);
+    }
+#endif
+}
+
+bool BladeMMP::IsKernelSupported(KERNEL kernel)
+{
+    switch (kernel)
+    {
+        case KERNEL_SCALAR:
+            return true;
+#ifdef MMP_X86
+        case KERNEL_SSSE3:
+        {
+            static const bool supported = HasSSSE3();
+            return supported;
+        }
+        case KERNEL_AVX2:
+        {
+            static const bool supported = HasAVX2();
+            return supported;
+        }
+#endif
+#ifdef MMP_NEON
+        case KERNEL_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+BladeMMP::KERNEL BladeMMP::GetBestKernel()
+{
+    for (KERNEL kernel : {KERNEL_AVX2, KERNEL_NEON, KERNEL_SSSE3})
+    {
+        if (IsKernelSupported(kernel))
+            return kernel;
+    }
+    return KERNEL_SCALAR;
+}
+
+const char* BladeMMP::GetKernelName(KERNEL kernel)
+{
+    switch (kernel)
+    {
+        case KERNEL_SCALAR:
+            return "scalar";
+        case KERNEL_SSSE3:
+            return "ssse3";
+        case KERNEL_AVX2:
+            return "avx2";
+        case KERNEL_NEON:
+            return "neon";
+    }
+    return "unknown";
+}
+
+void BladeMMP::ExpandPalette(const uint8_t* indices, const uint8_t* palette, size_t count, void* rgba, KERNEL kernel)
+{
+    uint8_t* dst = reinterpret_cast<uint8_t*>(rgba);
+
+    if (kernel == KERNEL_SCALAR)
+    {
+        // Reference implementation
+        for (size_t k = 0; k < count; ++k)
+        {
+            dst[k * 4    ] = palette[indices[k] * 3    ] << 2;
+            dst[k * 4 + 1] = palette[indices[k] * 3 + 1] << 2;
+            dst[k * 4 + 2] = palette[indices[k] * 3 + 2] << 2;
+            dst[k * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    // A 256-entry table can't be held in vector registers, so the other kernels look up whole pixels
+    // (AVX2 gathers eight at once)
+    uint32_t table[256];
+    MakePaletteTable(palette, table);
+
+#ifdef MMP_X86
+    if (kernel == KERNEL_AVX2)
+    {
+        ExpandPaletteAVX2(indices, table, count, dst);
+        return;
+    }
+#endif
+    ExpandPaletteTable(indices, table, 0, count, dst);
+}
+
+void BladeMMP::ExpandGrayscale(const uint8_t* src, size_t count, void* rgba, KERNEL kernel)
+{
+    uint8_t* dst = reinterpret_cast<uint8_t*>(rgba);
+
+    switch (kernel)
+    {
+#ifdef MMP_X86
+        case KERNEL_SSSE3:
+            ExpandGrayscaleSSE(src, count, dst);
+            return;
+        case KERNEL_AVX2:
+            ExpandGrayscaleAVX2(src, count, dst);
+            return;
+#endif
+#ifdef MMP_NEON
+        case KERNEL_NEON:
+            ExpandGrayscaleNEON(src, count, dst);
+            return;
+#endif
+        default:
+            ExpandGrayscaleScalar(src, 0, count, dst);
+            return;
+    }
+}
+
+void BladeMMP::ExpandRGB(const uint8_t* src, size_t count, void* rgba, KERNEL kernel)
+{
+    uint8_t* dst = reinterpret_cast<uint8_t*>(rgba);
+
+    switch (kernel)
+    {
+#ifdef MMP_X86
+        case KERNEL_SSSE3:
+            ExpandRGBSSE(src, count, dst);
+            return;
+        case KERNEL_AVX2:
+            ExpandRGBAVX2(src, count, dst);
+            return;
+#endif
+#ifdef MMP_NEON
+        case KERNEL_NEON:
+            ExpandRGBNEON(src, count, dst);
+            return;
+#endif
+        default:
+            ExpandRGBScalar(src, 0, count, dst);
+            return;
+    }
+}
+
+bool BladeMMP::Decode(TextureHeader const& header, const void* data, void* rgba)
+{
+    return Decode(header, data, rgba, GetBestKernel());
+}
+
+bool BladeMMP::Decode(TextureHeader const& header, const void* data, void* rgba, KERNEL kernel)
+{
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data);
+
+    size_t pixelCount = size_t(header.Width) * header.Height;
+
+    switch (header.Type)
+    {
+        case TT_PALETTE:
+            if (header.DataSize < pixelCount + 768)
+                return false;
+
+            ExpandPalette(src, src + pixelCount, pixelCount, rgba, kernel);
+            return true;
+
+        case TT_GRAYSCALED:
+            if (header.DataSize < pixelCount)
+                return false;
+
+            ExpandGrayscale(src, pixelCount, rgba, kernel);
+            return true;
+
+        case TT_TRUECOLOR:
+            if (header.DataSize >= pixelCount * 4)
+            {
+                Core::Memcpy(rgba, src, pixelCount * 4);
+                return true;
+            }
+
+            if (header.DataSize < pixelCount * 3)
+                return false;
+
+            ExpandRGB(src, pixelCount, rgba, kernel);
+            return true;
+
+        default:
+            break;
+    }
+    return false;
+}
@@ -0,0 +1,89 @@
+﻿/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/IO.h>
+#include <Hork/Core/String.h>
+
+#include "../Utils/NameTable.h"
+
+using namespace Hk;
+
+class BladeMMP
+{
+public:
+    enum TEXTURE_TYPE : int32_t
+    {
+        TT_PALETTE          = 1,
+        TT_GRAYSCALED       = 2,
+        TT_TRUECOLOR        = 4
+    };
+
+    struct TextureHeader
+    {
+        int16_t             Unknown;
+        uint32_t            Checksum;
+        String              Name;
+        NameAtom            Atom;
+        TEXTURE_TYPE        Type;
+        int32_t             Width;
+        int32_t             Height;
+
+        // Offset of the texture data from the beginning of the pack
+        size_t              DataOffset;
+        size_t              DataSize;
+    };
+
+    // Reads the header of the next texture. The file is left at the beginning of the texture data.
+    static bool             ReadHeader(File& file, TextureHeader& header);
+
+    // Implementations of the pixel expansion. All produce the same output as the scalar reference.
+    enum KERNEL
+    {
+        KERNEL_SCALAR,
+        KERNEL_SSSE3,
+        KERNEL_AVX2,
+        KERNEL_NEON
+    };
+
+    // Expands texture data to RGBA8 with the best kernel of the CPU. The output buffer must hold Width * Height * 4 bytes.
+    static bool             Decode(TextureHeader const& header, const void* data, void* rgba);
+
+    // Same with the given kernel, which must be supported
+    static bool             Decode(TextureHeader const& header, const void* data, void* rgba, KERNEL kernel);
+
+    static bool             IsKernelSupported(KERNEL kernel);
+    static KERNEL           GetBestKernel();
+    static const char*      GetKernelName(KERNEL kernel);
+
+    // Palette entries are 6-bit RGB, 768 bytes in total
+    static void             ExpandPalette(const uint8_t* indices, const uint8_t* palette, size_t count, void* rgba, KERNEL kernel);
+    static void             ExpandGrayscale(const uint8_t* src, size_t count, void* rgba, KERNEL kernel);
+    static void             ExpandRGB(const uint8_t* src, size_t count, void* rgba, KERNEL kernel);
+};
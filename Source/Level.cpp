@@ -29,7 +29,15 @@ SOFTWARE.
 #include "Level.h"
 #include "Utils/FileDump.h"
 #include "Utils/ConversionUtils.h"
+#include "Utils/Hash.h"
+#include "Utils/ParallelFor.h"
+#include "Utils/MappedFile.h"
+#include "Utils/MeshOptimizer.h"
+#include "Utils/BlockCompression.h"
+#include "Utils/PortalCulling.h"
+#include "Utils/SectorPVS.h"
 #include "DataFormats/BW.h"
+#include "DataFormats/MMP.h"
 
 #include <Hork/Runtime/GameApplication/GameApplication.h>
 #include <Hork/Runtime/World/Modules/Render/Components/MeshComponent.h>
@@ -38,17 +46,11 @@ SOFTWARE.
 #include <Hork/Geometry/ConvexHull.h>
 #include <Hork/Geometry/TangentSpace.h>
 
-using namespace Hk;
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 
-namespace
-{
-    enum TEXTURE_TYPE
-    {
-        TT_PALETTE      = 1,
-        TT_GRAYSCALED   = 2,
-        TT_TRUECOLOR    = 4
-    };
-}
+using namespace Hk;
 
 void BladeLevel::Load(World* world, StringView name)
 {
@@ -113,6 +115,14 @@ void BladeLevel::Load(World* world, StringView name)
 
     if (!bwfile.IsEmpty())
         LoadWorld(bwfile);
+
+    m_Profile.SetTotalTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_ProfileStart).count());
+}
+
+void BladeLevel::ResetLoadProfile(StringView name)
+{
+    m_Profile.Reset(name);
+    m_ProfileStart = std::chrono::steady_clock::now();
 }
 
 // Load Skydome from .MMP file
@@ -128,6 +138,8 @@ void BladeLevel::LoadDome(StringView fileName)
         "DomeFront"
     };
 
+    ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_DOME);
+
     auto& resourceMngr = GameApplication::sGetResourceManager();
 
     File file = File::sOpenRead(fileName);
@@ -141,19 +153,20 @@ void BladeLevel::LoadDome(StringView fileName)
     
     for (int i = 0; i < texCount; i++)
     {
-        file.ReadInt16(); // unknown
-        file.ReadInt32(); // checksum
+        BladeMMP::TextureHeader header;
+        if (!BladeMMP::ReadHeader(file, header))
+        {
+            LOG("Invalid MMP {}\n", fileName);
+            return;
+        }
 
-        int32_t size = file.ReadInt32();
-        String textureName = file.ReadString();
-        int32_t type = file.ReadInt32();
-        int32_t width = file.ReadInt32();
-        int32_t height = file.ReadInt32();
+        int32_t width = header.Width;
+        int32_t height = header.Height;
 
         int faceNum;
         for (faceNum = 0; faceNum < 6; ++faceNum)
         {
-            if (!textureName.Icmp(domeNames[faceNum]))
+            if (!header.Name.Icmp(domeNames[faceNum]))
                 break;
         }
 
@@ -176,63 +189,10 @@ void BladeLevel::LoadDome(StringView fileName)
             return;
         }
 
-        int32_t textureDataSize = size - 12;
-        HeapBlob textureData = file.ReadBlob(textureDataSize);
+        HeapBlob textureData = file.ReadBlob(header.DataSize);
 
-        switch (type)
-        {
-            case TT_PALETTE:
-            {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(textureData.GetData());
-                const uint8_t* palette = reinterpret_cast<const uint8_t*>(textureData.GetData()) + width * height;
-                uint8_t* trueColor = reinterpret_cast<uint8_t*>(trueColorData.GetData());
-
-                for (int j = 0; j < height; ++j)
-                {
-                    for (int k = j * width; k < (j + 1) * width; ++k)
-                    {
-                        trueColor[k * 4    ] = palette[data[k] * 3    ] << 2;
-                        trueColor[k * 4 + 1] = palette[data[k] * 3 + 1] << 2;
-                        trueColor[k * 4 + 2] = palette[data[k] * 3 + 2] << 2;
-                        trueColor[k * 4 + 3] = 255;
-                    }
-                }
-                break;
-            }
-            case TT_GRAYSCALED:
-            {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(textureData.GetData());
-                uint8_t* trueColor = reinterpret_cast<uint8_t*>(trueColorData.GetData());
-                for (int j = 0; j < height; ++j)
-                {
-                    for (int k = j * width; k < (j + 1) * width; ++k)
-                    {
-                        trueColor[k * 4    ] = data[k];
-                        trueColor[k * 4 + 1] = data[k];
-                        trueColor[k * 4 + 2] = data[k];
-                        trueColor[k * 4 + 3] = 255;
-                    }
-                }
-                break;
-            }
-            case TT_TRUECOLOR:
-            {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(textureData.GetData());
-                uint8_t* trueColor = reinterpret_cast<uint8_t*>(trueColorData.GetData());
-                int count = width * height * 3;
-                for (int j = 0, k = 0; j < count; j += 3, k += 4)
-                {
-                    trueColor[k    ] = data[j    ];
-                    trueColor[k + 1] = data[j + 1];
-                    trueColor[k + 2] = data[j + 2];
-                    trueColor[k + 3] = 255;
-                }
-                break;
-            }
-            default:
-                LOG("Unknown texture type\n");
-                break;
-        }
+        if (!BladeMMP::Decode(header, textureData.GetData(), trueColorData.GetData()))
+            LOG("Unknown texture type\n");
 
         if (faceNum == 2) // Up
         {
@@ -260,99 +220,366 @@ void BladeLevel::LoadDome(StringView fileName)
 
 void BladeLevel::LoadTextures(StringView fileName)
 {
-    auto& resourceMngr = GameApplication::sGetResourceManager();
+    Vector<String> fileNames;
+    fileNames.Add(String(fileName));
+    LoadTextures(fileNames);
+}
 
-    File file = File::sOpenRead(fileName);
-    if (!file)
-        return;
+void BladeLevel::LoadTextures(Vector<String> const& fileNames)
+{
+    uint32_t firstPack = m_TexturePacks.Size();
+    m_TexturePacks.Resize(firstPack + fileNames.Size());
 
-    RawImage image;
+    // Only the headers are read here, the texture data is skipped
+    Vector<Vector<BladeMMP::TextureHeader>> packs(fileNames.Size());
+    Vector<uint64_t> packHashes(fileNames.Size());
+    ParallelFor(fileNames.Size(), [&](size_t packNum)
+        {
+            TexturePack& pack = m_TexturePacks[firstPack + packNum];
+            pack.FileName = fileNames[packNum];
 
-    int32_t texCount = file.ReadInt32();
-    for (int i = 0; i < texCount; i++)
+            File file = File::sOpenRead(fileNames[packNum]);
+            if (!file)
+                return;
+
+            int32_t texCount = file.ReadInt32();
+            for (int i = 0; i < texCount; i++)
+            {
+                BladeMMP::TextureHeader header;
+                if (!BladeMMP::ReadHeader(file, header) || header.Unknown != 2 || header.DataOffset + header.DataSize > file.GetSize())
+                {
+                    LOG("Invalid MMP {}\n", fileNames[packNum]);
+                    return;
+                }
+
+                file.SeekSet(header.DataOffset + header.DataSize);
+                packs[packNum].Add(std::move(header));
+            }
+
+            if (m_CacheDirectory.IsEmpty())
+                return;
+
+            ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_TEXTURE_CACHE);
+
+            Vector<BladeMMP::TextureHeader> const& headers = packs[packNum];
+            packHashes[packNum] = CompressedTexturePack::sHashPack(headers);
+
+            // Packs of different maps share names, so the cache file is named by the contents too
+            pack.CacheFileName = m_CacheDirectory / PathUtils::sGetFilenameNoExt(PathUtils::sGetFilename(fileNames[packNum])) + "_" + Core::ToHexString(packHashes[packNum], true) + ".btc";
+            if (!pack.Compressed.Load(pack.CacheFileName, packHashes[packNum]) || pack.Compressed.Textures.Size() != headers.Size())
+                pack.Compressed.Textures.Clear();
+        });
+
+    // Textures that are not shared with an already indexed one get their own entry
+    Vector<Vector<uint8_t>> ownEntries(fileNames.Size());
+    for (uint32_t packNum = 0; packNum < fileNames.Size(); ++packNum)
     {
-        int16_t unknown = file.ReadInt16();
-        if (unknown != 2)
+        uint32_t pack = firstPack + packNum;
+
+        ownEntries[packNum].Resize(packs[packNum].Size());
+        for (uint32_t packTexture = 0; packTexture < packs[packNum].Size(); ++packTexture)
         {
-            LOG("Invalid MMP {}\n", fileName);
-            return;
-        }
+            BladeMMP::TextureHeader const& header = packs[packNum][packTexture];
+            ownEntries[packNum][packTexture] = 0;
+
+            // Many packs carry the same textures, also under other names. A texture with the same data as an already
+            // indexed one points its name at that entry, so the data is decoded and uploaded once for all names.
+            uint64_t dataSize = header.DataSize;
+            uint64_t dedupKey = HashFNV1a(&header.Checksum, sizeof(header.Checksum));
+            dedupKey = HashFNV1a(&header.Type, sizeof(header.Type), dedupKey);
+            dedupKey = HashFNV1a(&header.Width, sizeof(header.Width), dedupKey);
+            dedupKey = HashFNV1a(&header.Height, sizeof(header.Height), dedupKey);
+            dedupKey = HashFNV1a(&dataSize, sizeof(dataSize), dedupKey);
+
+            auto dup = m_TextureDedup.Find(dedupKey);
+            if (dup != m_TextureDedup.End())
+            {
+                BladeMMP::TextureHeader const& original = m_TextureEntries[dup->second].Header;
+                if (original.Checksum == header.Checksum && original.Type == header.Type && original.Width == header.Width &&
+                    original.Height == header.Height && original.DataSize == header.DataSize)
+                {
+                    m_TextureLookup[header.Atom] = dup->second;
+                    continue;
+                }
+            }
+
+            uint32_t entryIndex = m_TextureEntries.Size();
 
-        file.ReadInt32(); // checksum
+            TextureEntry& entry = m_TextureEntries.EmplaceBack();
+            entry.Header = header;
+            entry.Pack = pack;
+            entry.PackTexture = packTexture;
 
-        int32_t size = file.ReadInt32();
-        String textureName = file.ReadString();
-        int32_t type = file.ReadInt32();
-        int32_t width = file.ReadInt32();
-        int32_t height = file.ReadInt32();
+            m_TextureLookup[entry.Header.Atom] = entryIndex;
+            m_TextureDedup[dedupKey] = entryIndex;
+            ownEntries[packNum][packTexture] = 1;
 
-        int32_t textureDataSize = size - 12;
-        HeapBlob textureData = file.ReadBlob(textureDataSize);
+            m_Profile.Increment(LoadProfile::COUNTER_TEXTURES_INDEXED);
+        }
+    }
 
-        image.Reset(width, height, RAW_IMAGE_FORMAT_RGBA8);
+    if (m_CacheDirectory.IsEmpty())
+        return;
 
-        switch (type)
+    // Textures are uploaded as BC1 blocks from the cache. A pack is compressed when one of its entries has no blocks
+    // in the cache yet. Textures shared with another pack are left out, and a texture that can't be decoded is written
+    // without blocks, so it isn't tried again on the next start.
+    ParallelFor(fileNames.Size(), [&](size_t packNum)
         {
-            case TT_PALETTE:
+            TexturePack& pack = m_TexturePacks[firstPack + packNum];
+            if (pack.CacheFileName.IsEmpty())
+                return;
+
+            Vector<BladeMMP::TextureHeader> const& headers = packs[packNum];
+            Vector<CompressedTexturePack::Texture>& textures = pack.Compressed.Textures;
+
+            bool missing = false;
+            for (uint32_t i = 0; i < headers.Size() && !missing; ++i)
+                missing = ownEntries[packNum][i] && (textures.IsEmpty() || textures[i].MipCount == 0);
+            if (!missing)
+                return;
+
+            ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_TEXTURE_CACHE);
+
+            File file = File::sOpenRead(pack.FileName);
+            if (!file)
+                return;
+
+            // Blocks of an older cache of the pack are carried over
+            Vector<HeapBlob> blocks(headers.Size());
+            if (textures.IsEmpty())
             {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(textureData.GetData());
-                const uint8_t* palette = reinterpret_cast<const uint8_t*>(textureData.GetData()) + width * height;
-                uint8_t* trueColor = reinterpret_cast<uint8_t*>(image.GetData());
+                textures.Resize(headers.Size());
+                for (uint32_t i = 0; i < headers.Size(); ++i)
+                    textures[i] = CompressedTexturePack::sLeaveOut(headers[i]);
+            }
+            else
+            {
+                MappedFile cacheFile;
+                if (!cacheFile.Open(pack.CacheFileName))
+                {
+                    textures.Clear();
+                    return;
+                }
 
-                for (int j = 0; j < height; ++j)
+                for (uint32_t i = 0; i < headers.Size(); ++i)
                 {
-                    for (int k = j * width; k < (j + 1) * width; ++k)
+                    if (textures[i].DataSize)
                     {
-                        trueColor[k * 4    ] = palette[data[k] * 3    ] << 2;
-                        trueColor[k * 4 + 1] = palette[data[k] * 3 + 1] << 2;
-                        trueColor[k * 4 + 2] = palette[data[k] * 3 + 2] << 2;
-                        trueColor[k * 4 + 3] = 255;
+                        blocks[i].Reset(textures[i].DataSize);
+                        std::memcpy(blocks[i].GetData(), cacheFile.GetData() + textures[i].DataOffset, textures[i].DataSize);
                     }
                 }
-                break;
             }
-            case TT_GRAYSCALED:
+
+            for (uint32_t i = 0; i < headers.Size(); ++i)
             {
-                const uint8_t* data = reinterpret_cast<const uint8_t*>(textureData.GetData());
-                uint8_t* trueColor = reinterpret_cast<uint8_t*>(image.GetData());
-                for (int j = 0; j < height; ++j)
-                {
-                    for (int k = j * width; k < (j + 1) * width; ++k)
-                    {
-                        trueColor[k * 4    ] = data[k];
-                        trueColor[k * 4 + 1] = data[k];
-                        trueColor[k * 4 + 2] = data[k];
-                        trueColor[k * 4 + 3] = 255;
-                    }
-                }
-                break;
+                if (!ownEntries[packNum][i] || textures[i].MipCount != 0)
+                    continue;
+
+                file.SeekSet(headers[i].DataOffset);
+                HeapBlob textureData = file.ReadBlob(headers[i].DataSize);
+
+                blocks[i] = CompressedTexturePack::sCompress(headers[i], textureData.GetData(), textures[i]);
+                if (blocks[i].IsEmpty())
+                    LOG("Failed to compress texture {} from {}\n", headers[i].Name, pack.FileName);
             }
-            case TT_TRUECOLOR:
+
+            std::error_code ec;
+            std::filesystem::create_directories(m_CacheDirectory.CStr(), ec);
+
+            // The cache is written under a temporary name and moved in place, so the file under the final name is
+            // always complete
+            String tempFileName = pack.CacheFileName + "." + Core::ToHexString(uint32_t(firstPack + packNum), true) + ".tmp";
+            bool saved = pack.Compressed.Save(tempFileName, packHashes[packNum], blocks);
+            if (saved)
             {
-                Core::Memcpy(image.GetData(), textureData.GetData(), textureData.Size());
-                break;
+                std::filesystem::rename(tempFileName.CStr(), pack.CacheFileName.CStr(), ec);
+                saved = !ec;
             }
-            default:
+            if (!saved)
+            {
+                LOG("Failed to write texture cache {}\n", pack.CacheFileName);
+                std::filesystem::remove(tempFileName.CStr(), ec);
+                textures.Clear();
+            }
+        });
+}
+
+void BladeLevel::PrefetchTextures(Vector<NameAtom> const& textureAtoms)
+{
+    Vector<uint32_t> textureEntries;
+    for (NameAtom atom : textureAtoms)
+    {
+        auto it = m_TextureLookup.Find(atom);
+        if (it == m_TextureLookup.End())
+            continue;
+
+        AddTextureUser(it->second, atom);
+        if (!m_TextureEntries[it->second].Loaded)
+            textureEntries.Add(it->second);
+    }
+
+    std::sort(textureEntries.begin(), textureEntries.end());
+    textureEntries.Resize(std::unique(textureEntries.begin(), textureEntries.end()) - textureEntries.begin());
+
+    DecodeTextures(textureEntries);
+}
+
+void BladeLevel::DecodeTextures(Vector<uint32_t> const& textureEntries)
+{
+    auto& resourceMngr = GameApplication::sGetResourceManager();
+
+    // Cached blocks are uploaded as they are, straight from the cache files. Each file is mapped once per call.
+    HashMap<uint32_t, uint32_t> cacheFileLookup;
+    Vector<UniqueRef<MappedFile>> cacheFiles;
+    Vector<const uint8_t*> blocks(textureEntries.Size());
+    for (uint32_t i = 0; i < textureEntries.Size(); ++i)
+    {
+        TextureEntry const& entry = m_TextureEntries[textureEntries[i]];
+        TexturePack const& pack = m_TexturePacks[entry.Pack];
+
+        blocks[i] = nullptr;
+        if (pack.Compressed.Textures.IsEmpty())
+            continue;
+
+        uint32_t cacheFileIndex;
+        auto it = cacheFileLookup.Find(entry.Pack);
+        if (it != cacheFileLookup.End())
+        {
+            cacheFileIndex = it->second;
+        }
+        else
+        {
+            auto cacheFile = MakeUnique<MappedFile>();
+            if (!cacheFile->Open(pack.CacheFileName))
+                LOG("Failed to open texture cache {}\n", pack.CacheFileName);
+
+            cacheFileIndex = cacheFiles.Size();
+            cacheFileLookup[entry.Pack] = cacheFileIndex;
+            cacheFiles.Add(std::move(cacheFile));
+        }
+
+        MappedFile const& cacheFile = *cacheFiles[cacheFileIndex].RawPtr();
+        CompressedTexturePack::Texture const& compressed = pack.Compressed.Textures[entry.PackTexture];
+        if (compressed.DataSize && compressed.Checksum == entry.Header.Checksum && compressed.DataOffset + compressed.DataSize <= cacheFile.GetSize())
+            blocks[i] = cacheFile.GetData() + compressed.DataOffset;
+    }
+
+    // Reading, decoding and mipmapping don't touch the engine state, so they run on worker threads
+    Vector<ImageStorage> images(textureEntries.Size());
+    Vector<uint8_t> decoded(textureEntries.Size());
+    ParallelFor(textureEntries.Size(), [&](size_t i)
+        {
+            if (blocks[i])
+            {
+                decoded[i] = 1;
+                return;
+            }
+
+            TextureEntry const& entry = m_TextureEntries[textureEntries[i]];
+            TexturePack const& pack = m_TexturePacks[entry.Pack];
+            BladeMMP::TextureHeader const& header = entry.Header;
+
+            File file = File::sOpenRead(pack.FileName);
+            if (!file)
+                return;
+
+            ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_TEXTURE_DECODE);
+
+            file.SeekSet(header.DataOffset);
+            HeapBlob textureData = file.ReadBlob(header.DataSize);
+
+            RawImage image;
+            image.Reset(header.Width, header.Height, RAW_IMAGE_FORMAT_RGBA8);
+
+            if (!BladeMMP::Decode(header, textureData.GetData(), image.GetData()))
                 LOG("Unknown texture type\n");
-                break;
+
+            ImageMipmapConfig mipmapConfig; // use default params
+            images[i] = CreateImage(image, &mipmapConfig, IMAGE_STORAGE_NO_ALPHA, IMAGE_IMPORT_FLAGS_DEFAULT);
+            decoded[i] = 1;
+        });
+
+    // Resources are created on the calling thread
+    for (uint32_t i = 0; i < textureEntries.Size(); ++i)
+    {
+        TextureEntry& entry = m_TextureEntries[textureEntries[i]];
+        entry.Loaded = true;
+
+        if (!decoded[i])
+        {
+            LOG("Failed to read texture {} from {}\n", entry.Header.Name, m_TexturePacks[entry.Pack].FileName);
+            continue;
+        }
+
+        entry.Texture = resourceMngr.Acquire<Texture>(entry.Header.Name);
+
+        if (blocks[i])
+        {
+            CompressedTexturePack::Texture const& compressed = m_TexturePacks[entry.Pack].Compressed.Textures[entry.PackTexture];
+
+            entry.Texture->Allocate2D(TEXTURE_FORMAT_BC1_UNORM_SRGB, compressed.MipCount, compressed.Width, compressed.Height);
+
+            const uint8_t* mipBlocks = blocks[i];
+            for (uint32_t mip = 0; mip < compressed.MipCount; ++mip)
+            {
+                uint32_t mipWidth = Math::Max(uint32_t(compressed.Width) >> mip, 1u);
+                uint32_t mipHeight = Math::Max(uint32_t(compressed.Height) >> mip, 1u);
+
+                entry.Texture->WriteData2D(0, 0, mipWidth, mipHeight, mip, mipBlocks);
+                mipBlocks += BlockCompression::GetBC1Size(mipWidth, mipHeight);
+            }
+
+            m_Profile.Increment(LoadProfile::COUNTER_TEXTURES_COMPRESSED);
+            m_Profile.Increment(LoadProfile::COUNTER_BYTES_UPLOADED, compressed.DataSize);
+        }
+        else
+        {
+            entry.Texture->CreateFromImage(std::move(images[i]));
+
+            m_Profile.Increment(LoadProfile::COUNTER_BYTES_UPLOADED, size_t(entry.Header.Width) * entry.Header.Height * 4);
         }
 
-        ImageMipmapConfig mipmapConfig; // use default params
-        ImageStorage imageStorage = CreateImage(image, &mipmapConfig, IMAGE_STORAGE_NO_ALPHA, IMAGE_IMPORT_FLAGS_DEFAULT);
+        m_Profile.Increment(LoadProfile::COUNTER_TEXTURES);
+    }
+}
+
+void BladeLevel::AddTextureUser(uint32_t entryIndex, NameAtom atom)
+{
+    TextureEntry& entry = m_TextureEntries[entryIndex];
+    for (NameAtom user : entry.Users)
+    {
+        if (user == atom)
+            return;
+    }
+
+    if (!entry.Users.IsEmpty())
+    {
+        CompressedTexturePack const& compressed = m_TexturePacks[entry.Pack].Compressed;
 
-        auto texture = resourceMngr.Acquire<Texture>(textureName);
-        texture->CreateFromImage(std::move(imageStorage));
+        size_t uploadSize = size_t(entry.Header.Width) * entry.Header.Height * 4;
+        if (!compressed.Textures.IsEmpty() && compressed.Textures[entry.PackTexture].DataSize)
+            uploadSize = compressed.Textures[entry.PackTexture].DataSize;
 
-        m_Textures.EmplaceBack(std::move(texture));
+        m_Profile.Increment(LoadProfile::COUNTER_TEXTURES_SHARED);
+        m_Profile.Increment(LoadProfile::COUNTER_BYTES_SHARED, uploadSize);
     }
+    entry.Users.Add(atom);
 }
 
 void BladeLevel::UnloadTextures()
 {
-    for (auto texture : m_Textures)
-        texture->Purge();
+    for (auto& entry : m_TextureEntries)
+    {
+        if (entry.Texture)
+            entry.Texture->Purge();
+    }
 
-    m_Textures.Clear();
+    m_TexturePacks.Clear();
+    m_TextureEntries.Clear();
+    m_TextureLookup.Clear();
+    m_TextureDedup.Clear();
 }
 
 namespace Hk
@@ -400,15 +627,18 @@ namespace
 {
 #define USE_TEXCOORD_CORRECTION
 
-    void CalcTextureCoorinates(const Double3 texCoordAxis[2], const float texCoordOffset[2], MeshVertex* vertices, int numVertices, int texWidth, int texHeight)
+    void CalcTextureCoorinates(const Double3 texCoordAxis[2], const float texCoordOffset[2], MeshVertex* vertices, int numVertices, int texWidth, int texHeight,
+        Vector<Double2>& tempTexcoords, LoadProfile* profile)
     {
+        ScopedPhaseTimer timer(profile, LoadProfile::PHASE_TEXCOORDS);
+
         double sx = 1.0 / texWidth;
         double sy = 1.0 / texHeight;
 
 #ifdef USE_TEXCOORD_CORRECTION
         Double2 mins(std::numeric_limits<double>::max());
 
-        Vector<Double2> tempTexcoords(numVertices);
+        tempTexcoords.Resize(numVertices);
 
         for (int k = 0; k < numVertices; ++k)
         {
@@ -441,46 +671,590 @@ namespace
 #endif
     }
 
-    HK_NODISCARD Vector<Double3> CreateWinding(Vector<Double3> const& vertices, Vector<uint32_t> const& windingIndices)
+    void CreateWinding(Vector<Double3> const& vertices, ArrayView<const uint32_t> windingIndices, Vector<Double3>& winding)
     {
         int windingSize = windingIndices.Size();
 
-        Vector<Double3> winding(windingSize);
+        winding.Resize(windingSize);
         for (int k = 0; k < windingSize; k++)
             winding[windingSize - k - 1] = vertices[windingIndices[k]];
+    }
+
+    HK_NODISCARD Vector<Double3> CreateWinding(Vector<Double3> const& vertices, ArrayView<const uint32_t> windingIndices)
+    {
+        Vector<Double3> winding;
+        CreateWinding(vertices, windingIndices, winding);
         return winding;
     }
 
+    // Result of the fast path for convex windings with convex holes
+    enum CONVEX_TRIANGULATION
+    {
+        CT_FAILED,      // A contour is not convex or holes cross the winding, PolyClipper is needed
+        CT_POLYGON,     // No hole overlaps the winding
+        CT_RING,        // One hole lies inside the winding
+        CT_COVERED      // The winding lies inside a hole, nothing to draw
+    };
+
+    // Distance tolerance in BW units
+    constexpr double ConvexEpsilon = 0.01;
+
+    double Cross2D(Double2 const& o, Double2 const& a, Double2 const& b)
+    {
+        return (a.X - o.X) * (b.Y - o.Y) - (a.Y - o.Y) * (b.X - o.X);
+    }
+
+    // Signed distance from the point to the line of the edge, positive on the left
+    double EdgeDistance(Double2 const& a, Double2 const& b, Double2 const& p)
+    {
+        Double2 edge = b - a;
+        double length = std::sqrt(Math::Dot(edge, edge));
+        return length > 0 ? Cross2D(a, b, p) / length : 0.0;
+    }
+
+    // Projects the contour onto the face plane and orders it counterclockwise around the normal.
+    // Returns false if the contour is not convex.
+    bool MakeConvexContour(Vector<Double3> const& in, Double3 const& axisU, Double3 const& axisV, Vector<Double3>& points, Vector<Double2>& contour)
+    {
+        uint32_t count = in.Size();
+        if (count < 3)
+            return false;
+
+        points = in;
+        contour.Resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+            contour[i] = Double2(Math::Dot(points[i], axisU), Math::Dot(points[i], axisV));
+
+        double area = 0;
+        for (uint32_t i = 0; i < count; ++i)
+            area += Cross2D(Double2(0.0), contour[i], contour[(i + 1) % count]);
+        if (std::abs(area) < ConvexEpsilon * ConvexEpsilon)
+            return false;
+
+        if (area < 0)
+        {
+            std::reverse(points.begin(), points.end());
+            std::reverse(contour.begin(), contour.end());
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (EdgeDistance(contour[i], contour[(i + 1) % count], contour[(i + 2) % count]) < -ConvexEpsilon)
+                return false;
+        }
+        return true;
+    }
+
+    // Both contours are convex and counterclockwise. Touching contours count as separated.
+    bool AreSeparated(Vector<Double2> const& a, Vector<Double2> const& b)
+    {
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            Vector<Double2> const& edges = pass == 0 ? a : b;
+            Vector<Double2> const& points = pass == 0 ? b : a;
+
+            for (uint32_t i = 0; i < edges.Size(); ++i)
+            {
+                bool separating = true;
+                for (Double2 const& p : points)
+                {
+                    if (EdgeDistance(edges[i], edges[(i + 1) % edges.Size()], p) > ConvexEpsilon)
+                    {
+                        separating = false;
+                        break;
+                    }
+                }
+                if (separating)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Minimal distance of the points to the inside of the edges. Negative if a point is outside.
+    double GetInsideDistance(Vector<Double2> const& contour, Vector<Double2> const& points)
+    {
+        double minDistance = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < contour.Size(); ++i)
+        {
+            for (Double2 const& p : points)
+                minDistance = std::min(minDistance, EdgeDistance(contour[i], contour[(i + 1) % contour.Size()], p));
+        }
+        return minDistance;
+    }
+
+    // Triangulates the area between a convex outer contour and a convex hole inside it by walking both contours
+    // at once, in angular order around the hole center where there is a choice. Returns false if the result is not a valid ring.
+    bool TriangulateRing(Vector<Double2> const& outer, Vector<Double2> const& hole, Vector<double>& outerAngles, Vector<double>& holeAngles, Vector<uint32_t>& indices)
+    {
+        uint32_t outerCount = outer.Size();
+        uint32_t holeCount = hole.Size();
+
+        Double2 center(0.0);
+        for (Double2 const& p : hole)
+            center = center + p;
+        center = center * (1.0 / holeCount);
+
+        // The segment from a hole vertex must not pass through the hole
+        auto isVisible = [&](uint32_t holeIndex, Double2 const& p)
+            {
+                Double2 const& prev = hole[(holeIndex + holeCount - 1) % holeCount];
+                Double2 const& next = hole[(holeIndex + 1) % holeCount];
+                return EdgeDistance(hole[holeIndex], next, p) <= ConvexEpsilon || EdgeDistance(prev, hole[holeIndex], p) <= ConvexEpsilon;
+            };
+
+        // Start from the closest pair of vertices that see each other
+        uint32_t holeStart = 0;
+        double bestDistance = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < holeCount; ++i)
+        {
+            if (!isVisible(i, outer[0]))
+                continue;
+            Double2 d = outer[0] - hole[i];
+            if (Math::Dot(d, d) < bestDistance)
+            {
+                bestDistance = Math::Dot(d, d);
+                holeStart = i;
+            }
+        }
+        if (bestDistance == std::numeric_limits<double>::max())
+            return false;
+
+        // Angles around the hole center, increasing along both contours from the start pair
+        double startAngle = std::atan2(outer[0].Y - center.Y, outer[0].X - center.X);
+        auto getAngles = [&](Vector<Double2> const& contour, uint32_t first, Vector<double>& angles)
+            {
+                uint32_t count = contour.Size();
+                angles.Resize(count + 1);
+                for (uint32_t k = 0; k <= count; ++k)
+                {
+                    Double2 const& p = contour[(first + k) % count];
+                    double angle = std::atan2(p.Y - center.Y, p.X - center.X) - startAngle;
+                    while (k > 0 && angle < angles[k - 1])
+                        angle += Math::_2PI;
+                    while (k == 0 && angle < -Math::_PI)
+                        angle += Math::_2PI;
+                    angles[k] = angle;
+                }
+            };
+
+        getAngles(outer, 0, outerAngles);
+        getAngles(hole, holeStart, holeAngles);
+
+        double ringArea = 0;
+        for (uint32_t i = 0; i < outerCount; ++i)
+            ringArea += Cross2D(Double2(0.0), outer[i], outer[(i + 1) % outerCount]);
+        for (uint32_t i = 0; i < holeCount; ++i)
+            ringArea -= Cross2D(Double2(0.0), hole[i], hole[(i + 1) % holeCount]);
+
+        double area = 0;
+        uint32_t a = 0, b = 0;
+        while (a < outerCount || b < holeCount)
+        {
+            uint32_t o0 = a % outerCount;
+            uint32_t h0 = (holeStart + b) % holeCount;
+
+            uint32_t o1 = (o0 + 1) % outerCount;
+            uint32_t h1 = (h0 + 1) % holeCount;
+
+            bool canAdvanceOuter = a < outerCount && isVisible(h0, outer[o1]) && Cross2D(outer[o0], outer[o1], hole[h0]) >= 0;
+            bool canAdvanceHole = b < holeCount && isVisible(h1, outer[o0]) && Cross2D(outer[o0], hole[h1], hole[h0]) >= 0;
+
+            if (canAdvanceOuter && canAdvanceHole)
+            {
+                canAdvanceOuter = outerAngles[a + 1] < holeAngles[b + 1];
+                canAdvanceHole = !canAdvanceOuter;
+            }
+
+            uint32_t i0, i1, i2;
+            if (canAdvanceOuter)
+            {
+                i0 = o0;
+                i1 = o1;
+                i2 = outerCount + h0;
+                ++a;
+            }
+            else if (canAdvanceHole)
+            {
+                i0 = o0;
+                i1 = outerCount + h1;
+                i2 = outerCount + h0;
+                ++b;
+            }
+            else
+                return false;
+
+            Double2 const& p0 = i0 < outerCount ? outer[i0] : hole[i0 - outerCount];
+            Double2 const& p1 = i1 < outerCount ? outer[i1] : hole[i1 - outerCount];
+            Double2 const& p2 = i2 < outerCount ? outer[i2] : hole[i2 - outerCount];
+
+            double triangleArea = Cross2D(p0, p1, p2);
+            if (triangleArea < -ConvexEpsilon * ConvexEpsilon)
+                return false;
+            area += triangleArea;
+
+            indices.Add(i0);
+            indices.Add(i1);
+            indices.Add(i2);
+        }
+
+        // Overlapping triangles would cover more than the ring
+        return std::abs(area - ringArea) <= 1e-6 * std::abs(ringArea) + ConvexEpsilon * ConvexEpsilon;
+    }
+
+    // Bounds of the contour projected onto the plane axes
+    void GetContourBounds(Vector<Double3> const& points, Double3 const& axisU, Double3 const& axisV, Double2& mins, Double2& maxs)
+    {
+        mins = Double2(std::numeric_limits<double>::max());
+        maxs = Double2(-std::numeric_limits<double>::max());
+        for (Double3 const& p : points)
+        {
+            Double2 projected(Math::Dot(p, axisU), Math::Dot(p, axisV));
+            mins = Math::Min(mins, projected);
+            maxs = Math::Max(maxs, projected);
+        }
+    }
+
+    // Orthonormal axes of the plane. Counterclockwise in (u, v) is counterclockwise around the normal.
+    void GetPlaneAxes(Double3 const& normal, Double3& axisU, Double3& axisV)
+    {
+        axisU = Math::Abs(normal.X) < 0.6 ? Math::Cross(normal, Double3(1, 0, 0)) : Math::Cross(normal, Double3(0, 1, 0));
+        axisU = axisU.Normalized();
+        axisV = Math::Cross(normal, axisU);
+    }
+
+    template <typename T>
+    size_t GetCapacityBytes(Vector<T> const& v)
+    {
+        return v.Capacity() * sizeof(T);
+    }
+
+    // Working buffers of TriangulateConvex. The result is in Vertices and Indices.
+    struct ConvexScratch
+    {
+        Vector<Double3> Vertices;
+        Vector<uint32_t> Indices;
+
+        Vector<Double3> OuterPoints;
+        Vector<Double3> HolePoints;
+        Vector<Double3> RingPoints;
+        Vector<Double2> Outer;
+        Vector<Double2> Hole;
+        Vector<Double2> Ring;
+        Vector<double> OuterAngles;
+        Vector<double> HoleAngles;
+
+        size_t GetAllocatedBytes() const
+        {
+            return GetCapacityBytes(Vertices) + GetCapacityBytes(Indices) +
+                GetCapacityBytes(OuterPoints) + GetCapacityBytes(HolePoints) + GetCapacityBytes(RingPoints) +
+                GetCapacityBytes(Outer) + GetCapacityBytes(Hole) + GetCapacityBytes(Ring) +
+                GetCapacityBytes(OuterAngles) + GetCapacityBytes(HoleAngles);
+        }
+    };
+
+    // Fast path for convex windings: a plain fan if no hole overlaps the winding, a ring if one convex hole lies inside it.
+    // Triangles are counterclockwise around the normal, the same as the triangulator makes them.
+    CONVEX_TRIANGULATION TriangulateConvex(Vector<Double3> const& winding, const Vector<Double3>* const* holes, uint32_t holeCount, Double3 const& normal,
+        ConvexScratch& scratch)
+    {
+        Vector<Double3>& outVertices = scratch.Vertices;
+        Vector<uint32_t>& outIndices = scratch.Indices;
+        Vector<Double3>& outerPoints = scratch.OuterPoints;
+        Vector<Double3>& holePoints = scratch.HolePoints;
+        Vector<Double3>& ringPoints = scratch.RingPoints;
+        Vector<Double2>& outer = scratch.Outer;
+        Vector<Double2>& hole = scratch.Hole;
+        Vector<Double2>& ring = scratch.Ring;
+
+        outVertices.Clear();
+        outIndices.Clear();
+
+        Double3 axisU, axisV;
+        GetPlaneAxes(normal, axisU, axisV);
+
+        if (!MakeConvexContour(winding, axisU, axisV, outerPoints, outer))
+            return CT_FAILED;
+
+        bool hasRing = false;
+
+        for (uint32_t holeNum = 0; holeNum < holeCount; ++holeNum)
+        {
+            if (!MakeConvexContour(*holes[holeNum], axisU, axisV, holePoints, hole))
+                return CT_FAILED;
+
+            if (AreSeparated(outer, hole))
+                continue;
+
+            if (GetInsideDistance(hole, outer) >= -ConvexEpsilon)
+                return CT_COVERED;
+
+            if (hasRing || GetInsideDistance(outer, hole) <= ConvexEpsilon)
+                return CT_FAILED;
+
+            hasRing = true;
+            std::swap(ringPoints, holePoints);
+            std::swap(ring, hole);
+        }
+
+        // Swapped rather than moved, so both buffers stay in the scratch
+        std::swap(outVertices, outerPoints);
+
+        if (!hasRing)
+        {
+            for (uint32_t i = 1; i + 1 < outer.Size(); ++i)
+            {
+                outIndices.Add(0);
+                outIndices.Add(i);
+                outIndices.Add(i + 1);
+            }
+            return CT_POLYGON;
+        }
+
+        if (!TriangulateRing(outer, ring, scratch.OuterAngles, scratch.HoleAngles, outIndices))
+        {
+            outVertices.Clear();
+            outIndices.Clear();
+            return CT_FAILED;
+        }
+
+        outVertices.Add(ringPoints);
+        return CT_RING;
+    }
+
+    struct CompiledFace
+    {
+        Vector<MeshVertex> Vertices;
+        Vector<uint32_t> Indices;
+        bool IsValid = false;
+    };
+
+    // Size of the level grid cells in meters
+    constexpr float ChunkCellSize = 16.0f;
+
+    // Shadow caster regions are not culled by sectors, only by the shadow cascades, so they can be larger
+    constexpr float ShadowChunkCellSize = 32.0f;
+
+    // Chunks never cross sectors, so the key combines the sector and the grid cell
+    uint64_t GetChunkCellKey(int32_t sector, Float3 const& position, float cellSize)
+    {
+        int32_t x = int32_t(Math::Floor(position.X / cellSize));
+        int32_t y = int32_t(Math::Floor(position.Y / cellSize));
+        int32_t z = int32_t(Math::Floor(position.Z / cellSize));
+
+        return (uint64_t(sector & 0x3fffff) << 42) | (uint64_t(x & 0x3fff) << 28) | (uint64_t(y & 0x3fff) << 14) | uint64_t(z & 0x3fff);
+    }
+
+    float GetHalfSurfaceArea(BvAxisAlignedBox const& bounds)
+    {
+        Float3 size = bounds.Maxs - bounds.Mins;
+        return size.X * size.Y + size.Y * size.Z + size.Z * size.X;
+    }
+
+    // Splits a texture batch into sectors and grid cells. A triangle goes to the cell of one of its vertices,
+    // the one whose bounds grow least, so chunk bounds stay tight.
+    void SplitIntoChunks(int32_t textureNum, Vector<MeshVertex> const& vertices, Vector<uint32_t> const& indices, Vector<int32_t> const& triangleSectors, float cellSize, Vector<LevelGeometryChunk>& chunks)
+    {
+        struct Cell
+        {
+            int32_t Sector;
+            BvAxisAlignedBox Bounds;
+            Vector<uint32_t> Triangles;
+        };
+
+        Vector<Cell> cells;
+        HashMap<uint64_t, uint32_t> cellLookup;
+
+        for (uint32_t triangle = 0; triangle < indices.Size() / 3; ++triangle)
+        {
+            Float3 const& p0 = vertices[indices[triangle * 3]].Position;
+            Float3 const& p1 = vertices[indices[triangle * 3 + 1]].Position;
+            Float3 const& p2 = vertices[indices[triangle * 3 + 2]].Position;
+
+            BvAxisAlignedBox triangleBounds;
+            triangleBounds.Clear();
+            triangleBounds.AddPoint(p0);
+            triangleBounds.AddPoint(p1);
+            triangleBounds.AddPoint(p2);
+
+            int32_t sector = triangleSectors[triangle];
+
+            uint64_t candidates[3] = {GetChunkCellKey(sector, p0, cellSize), GetChunkCellKey(sector, p1, cellSize), GetChunkCellKey(sector, p2, cellSize)};
+
+            uint64_t cellKey = candidates[0];
+            if (candidates[1] != cellKey || candidates[2] != cellKey)
+            {
+                float bestGrowth = std::numeric_limits<float>::max();
+                for (uint64_t candidate : candidates)
+                {
+                    float growth;
+                    auto it = cellLookup.Find(candidate);
+                    if (it != cellLookup.End())
+                    {
+                        BvAxisAlignedBox bounds = cells[it->second].Bounds;
+                        bounds.AddPoint(triangleBounds.Mins);
+                        bounds.AddPoint(triangleBounds.Maxs);
+                        growth = GetHalfSurfaceArea(bounds) - GetHalfSurfaceArea(cells[it->second].Bounds);
+                    }
+                    else
+                        growth = GetHalfSurfaceArea(triangleBounds);
+
+                    if (growth < bestGrowth)
+                    {
+                        bestGrowth = growth;
+                        cellKey = candidate;
+                    }
+                }
+            }
+
+            uint32_t cellIndex;
+            auto it = cellLookup.Find(cellKey);
+            if (it != cellLookup.End())
+            {
+                cellIndex = it->second;
+            }
+            else
+            {
+                cellIndex = cells.Size();
+                cellLookup[cellKey] = cellIndex;
+
+                Cell& cell = cells.EmplaceBack();
+                cell.Sector = sector;
+                cell.Bounds.Clear();
+            }
+
+            Cell& cell = cells[cellIndex];
+            cell.Bounds.AddPoint(triangleBounds.Mins);
+            cell.Bounds.AddPoint(triangleBounds.Maxs);
+            cell.Triangles.Add(triangle);
+        }
+
+        // Copy the geometry of every cell, keeping only the vertices it uses
+        constexpr uint32_t Unused = ~0u;
+        Vector<uint32_t> remap(vertices.Size());
+        for (uint32_t& index : remap)
+            index = Unused;
+
+        for (Cell const& cell : cells)
+        {
+            LevelGeometryChunk& chunk = chunks.EmplaceBack();
+            chunk.TextureNum = textureNum;
+            chunk.Sector = cell.Sector;
+            chunk.Indices.Reserve(cell.Triangles.Size() * 3);
+
+            for (uint32_t triangle : cell.Triangles)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    uint32_t index = indices[triangle * 3 + k];
+                    if (remap[index] == Unused)
+                    {
+                        remap[index] = chunk.Vertices.Size();
+                        chunk.Vertices.Add(vertices[index]);
+                    }
+                    chunk.Indices.Add(remap[index]);
+                }
+            }
+
+            for (uint32_t triangle : cell.Triangles)
+            {
+                for (int k = 0; k < 3; ++k)
+                    remap[indices[triangle * 3 + k]] = Unused;
+            }
+        }
+    }
 }
 
 void BladeLevel::LoadWorld(StringView fileName)
 {
-    //BladeWorld bw;
+    CompiledLevel compiledLevel;
 
-    if (!bw.Load(fileName))
-        return;
+    String cacheFileName;
+    uint64_t sourceHash = 0;
+    bool cached = false;
 
-    auto& resourceMngr = GameApplication::sGetResourceManager();
-    auto& materialMngr = GameApplication::sGetMaterialManager();
+    if (!m_CacheDirectory.IsEmpty())
+    {
+        ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_LEVEL_CACHE);
+
+        MappedFile source;
+        if (source.Open(fileName))
+        {
+            sourceHash = CompiledLevel::sHashSource(source.GetData(), source.GetSize());
+            // Maps of different mods share names, so the cache file is named by the contents too
+            cacheFileName = m_CacheDirectory / PathUtils::sGetFilenameNoExt(PathUtils::sGetFilename(fileName)) + "_" + Core::ToHexString(sourceHash, true) + ".bwc";
+
+            cached = compiledLevel.Load(cacheFileName, sourceHash);
+        }
+    }
 
-    // Create materials
-    m_Materials.Clear();
-    auto materialResource = resourceMngr.Acquire<Material>("/Root/materials/compiled/wall.mat");
-    for (auto& texture : m_Textures)
+    if (!cached)
     {
-        IntrusiveRef<MatInstance> matInstance(new MatInstance);
+        if (!CompileWorld(fileName, compiledLevel))
+            return;
+
+        if (!cacheFileName.IsEmpty())
+        {
+            ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_LEVEL_CACHE);
+
+            std::error_code ec;
+            std::filesystem::create_directories(m_CacheDirectory.CStr(), ec);
+
+            if (!compiledLevel.Save(cacheFileName, sourceHash))
+                LOG("Failed to write level cache {}\n", cacheFileName);
+        }
+    }
+
+    // Only the textures the level uses are decoded, all at once
+    Vector<NameAtom> levelTextures;
+    for (auto const& batch : compiledLevel.Batches)
+        levelTextures.Add(NameTable::Intern(batch.TextureName));
+    PrefetchTextures(levelTextures);
+
+    CreateWorldMeshes(compiledLevel);
+}
+
+struct BladeLevel::FaceScratch
+{
+    Vector<Double3> Winding;
+    FaceHoles Holes;
+
+    // Front and back fragments of the BSP splits, two slots per depth
+    Vector<Vector<Double3>> Fragments;
+
+    Vector<const Vector<Double3>*> LeafHoles;
+    ConvexScratch Convex;
+    Vector<Double2> Texcoords;
+
+    Vector<ClipperPolygon> ClipperPolygons;
+    Vector<Double2> TriangulatorVertices;
+    Vector<uint32_t> TriangulatorIndices;
 
-        matInstance->SetResource(materialResource);
-        matInstance->SetTexture(0, texture);
+    size_t GetAllocatedBytes() const
+    {
+        size_t bytes = GetCapacityBytes(Winding) + GetCapacityBytes(Holes.Contours) + GetCapacityBytes(Fragments) +
+            GetCapacityBytes(LeafHoles) + Convex.GetAllocatedBytes() + GetCapacityBytes(Texcoords) +
+            GetCapacityBytes(ClipperPolygons) + GetCapacityBytes(TriangulatorVertices) + GetCapacityBytes(TriangulatorIndices);
+        for (HoleContour const& contour : Holes.Contours)
+            bytes += GetCapacityBytes(contour.Points);
+        for (Vector<Double3> const& fragment : Fragments)
+            bytes += GetCapacityBytes(fragment);
+        return bytes;
+    }
+};
+
+bool BladeLevel::CompileWorld(StringView fileName, CompiledLevel& compiledLevel)
+{
+    {
+        ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_BW_PARSE);
 
-        m_Materials[texture->GetName()] = std::move(matInstance);
+        if (!bw.Load(fileName))
+            return false;
     }
 
     Vector<Vector<MeshVertex>> vertexBatches(bw.m_TextureNames.Size());
     Vector<Vector<uint32_t>> indexBatches(bw.m_TextureNames.Size());
-
-    Vector<MeshVertex> vertexBuffer;
-    Vector<uint32_t> indexBuffer;
+    Vector<Vector<int32_t>> sectorBatches(bw.m_TextureNames.Size()); // Sector of every triangle
 
     Vector<MeshVertex> skydomeVertexBuffer;
     Vector<uint32_t> skydomeIndexBuffer;
@@ -488,381 +1262,625 @@ void BladeLevel::LoadWorld(StringView fileName)
     Vector<MeshVertex> shadowVertexBuffer;
     Vector<uint32_t> shadowIndexBuffer;
 
-    GameObjectDesc desc;
-    GameObject* object;
-    m_World->CreateObject(desc, object);
+    // Faces with this texture don't cast shadows
+    NameAtom noShadowAtom = NameTable::Intern("blanca");
+
+    Vector<CompiledFace> compiledFaces(bw.m_Faces.Size());
+
+    // Faces don't depend on each other until they are merged into batches, so they are compiled in parallel.
+    // Phase timings of the compilation are summed over all threads.
+    // Every thread keeps its scratch buffers from face to face, so the compilation only allocates the output
+    // of each face and whatever it takes for the scratch to grow to the largest face.
+    ParallelFor(bw.m_Faces.Size(), [&](size_t faceIndex)
+        {
+            thread_local FaceScratch scratch;
 
-    MatInstanceRef skyMaterial = materialMngr.FindMaterial("skywall");
+            size_t scratchBytes = scratch.GetAllocatedBytes();
 
-    for (auto const& face : bw.m_Faces)
+            CompiledFace& compiledFace = compiledFaces[faceIndex];
+            compiledFace.IsValid = CompileFace(bw.m_Faces[faceIndex], scratch, compiledFace.Vertices, compiledFace.Indices);
+
+            size_t grownBytes = scratch.GetAllocatedBytes() - scratchBytes;
+            if (grownBytes)
+            {
+                m_Profile.Increment(LoadProfile::COUNTER_SCRATCH_GROWTHS);
+                m_Profile.Increment(LoadProfile::COUNTER_SCRATCH_BYTES, grownBytes);
+            }
+        });
+
+    // Merge in face order, so the batches are the same regardless of the thread count
+    for (int faceIndex = 0; faceIndex < bw.m_Faces.Size(); ++faceIndex)
     {
-        vertexBuffer.Clear();
-        indexBuffer.Clear();
+        BladeWorld::Face const& face = bw.m_Faces[faceIndex];
+        CompiledFace& compiledFace = compiledFaces[faceIndex];
 
-        PlaneD facePlane = ConvertPlane(bw.m_Planes[face.PlaneNum]);
-        Float3 faceNormal = Float3(facePlane.Normal);
+        if (!compiledFace.IsValid)
+            continue;
+
+        Vector<MeshVertex> const& vertexBuffer = compiledFace.Vertices;
+        Vector<uint32_t> const& indexBuffer = compiledFace.Indices;
 
-        if (face.Type == BladeWorld::FT_OPAQUE || face.Type == BladeWorld::FT_SKYDOME)
+        ScopedPhaseTimer batchTimer(&m_Profile, LoadProfile::PHASE_BATCH_MERGE);
+
+        if (face.Type != BladeWorld::FT_SKYDOME && bw.m_TextureAtoms[face.TextureNum] != noShadowAtom)
         {
-            for (uint32_t index : face.Winding)
-            {
-                auto& v = vertexBuffer.EmplaceBack();
+            // The shadow caster takes positions only, so vertices of neighbouring faces weld together
+            uint32_t firstVertex = shadowVertexBuffer.Size();
 
-                v.Position = Float3(bw.m_Vertices[index]);
-                v.SetNormal(faceNormal);
+            for (MeshVertex const& v : vertexBuffer)
+            {
+                MeshVertex& shadowVertex = shadowVertexBuffer.EmplaceBack();
+                shadowVertex = {};
+                shadowVertex.Position = v.Position;
             }
 
-            // triangle fan -> triangles
-            for (int j = 0; j < face.Winding.Size() - 2; ++j)
+            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
             {
-                indexBuffer.Add(0);
-                indexBuffer.Add(face.Winding.Size() - j - 2);
-                indexBuffer.Add(face.Winding.Size() - j - 1);
+                shadowIndexBuffer.Add(firstVertex + indexBuffer[i  ]);
+                shadowIndexBuffer.Add(firstVertex + indexBuffer[i+1]);
+                shadowIndexBuffer.Add(firstVertex + indexBuffer[i+2]);
             }
+        }
 
-            CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256);
-
-            for (auto& v : vertexBuffer)
-                v.Position = ConvertCoord(v.Position);
+        if (face.Type == BladeWorld::FT_SKYDOME)
+        {
+            Vector<MeshVertex>& vertexBatch = skydomeVertexBuffer;
+            Vector<uint32_t>& indexBatch = skydomeIndexBuffer;
 
-            //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
+            uint32_t firstVertex = vertexBatch.Size();
+            vertexBatch.Add(vertexBuffer);
+            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
+            {
+                indexBatch.Add(firstVertex + indexBuffer[i  ]);
+                indexBatch.Add(firstVertex + indexBuffer[i+1]);
+                indexBatch.Add(firstVertex + indexBuffer[i+2]);
+            }
         }
-        else if (face.Type == BladeWorld::FT_TRANSPARENT)
+        else
         {
-            // Do nothing
-            continue;
+            Vector<MeshVertex>& vertexBatch = vertexBatches[face.TextureNum];
+            Vector<uint32_t>& indexBatch = indexBatches[face.TextureNum];
+            Vector<int32_t>& sectorBatch = sectorBatches[face.TextureNum];
+
+            uint32_t firstVertex = vertexBatch.Size();
+            vertexBatch.Add(vertexBuffer);
+            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
+            {
+                indexBatch.Add(firstVertex + indexBuffer[i  ]);
+                indexBatch.Add(firstVertex + indexBuffer[i+1]);
+                indexBatch.Add(firstVertex + indexBuffer[i+2]);
+                sectorBatch.Add(face.SectorIndex);
+            }
         }
-        else if (face.Type == BladeWorld::FT_SINGLE_PORTAL)
-        {
-            PlaneD plane = bw.m_Planes[face.PlaneNum];
 
-            Vector<Double3> winding = CreateWinding(bw.m_Vertices, face.Winding);
-            Vector<Double3> hole = CreateWinding(bw.m_Vertices, face.Holes[0]);
+        compiledFace = CompiledFace();
+    }
 
-            PolyClipper clipper;
-            clipper.SetTransformFromNormal(Float3(plane.Normal));
-            clipper.AddSubj3D(winding.ToPtr(), winding.Size());
-            clipper.AddClip3D(hole.ToPtr(), hole.Size());
+    compiledFaces.Clear();
 
-            Vector<ClipperPolygon> resultPolygons;
-            clipper.MakeDiff(resultPolygons);
-
-            using MyTriangulator = Triangulator<Double2, Double2>;
-            Vector<Double2> resultVertices;
-            MyTriangulator triangulator(&resultVertices, &indexBuffer);
-            MyTriangulator::Polygon polygon;
-            polygon.Normal.X = 0;
-            polygon.Normal.Y = 0;
-            polygon.Normal.Z = 1;
-            for (int i = 0; i < resultPolygons.Size(); i++)
-            {
-                polygon.OuterContour = resultPolygons[i].Outer.ToPtr();
-                polygon.OuterContourVertexCount = resultPolygons[i].Outer.Size();
+    Vector<LevelGeometryChunk> chunks = CreateChunks(vertexBatches, indexBatches, sectorBatches);
+
+    vertexBatches.Clear();
+    indexBatches.Clear();
+    sectorBatches.Clear();
 
-                polygon.HoleContours.Resize(resultPolygons[i].Holes.Size());
-                for (int j = 0; j < resultPolygons[i].Holes.Size(); j++)
-                    polygon.HoleContours[j] = std::make_pair(resultPolygons[i].Holes[j].ToPtr(), resultPolygons[i].Holes[j].Size());
+    Vector<LevelGeometryChunk> shadowChunks = CreateShadowChunks(shadowVertexBuffer, shadowIndexBuffer);
 
-                triangulator.Triangulate(&polygon);
-            }    
+    shadowVertexBuffer.Clear();
+    shadowIndexBuffer.Clear();
 
-            const Float3x3& transformMatrix = clipper.GetTransform();
+    OptimizeBatches(chunks, shadowChunks, skydomeVertexBuffer, skydomeIndexBuffer);
 
-            vertexBuffer.Resize(resultVertices.Size());
-            for (int k = 0; k < resultVertices.Size(); k++)
+    ScopedPhaseTimer batchTimer(&m_Profile, LoadProfile::PHASE_BATCH_MERGE);
+
+    compiledLevel.Clear();
+    for (auto const& chunk : chunks)
+        compiledLevel.FillBatch(compiledLevel.Batches.EmplaceBack(), bw.m_TextureNames[chunk.TextureNum], chunk.Sector, chunk.Vertices, chunk.Indices);
+    compiledLevel.FillBatch(compiledLevel.Skydome, "skydome", -1, skydomeVertexBuffer, skydomeIndexBuffer);
+    for (auto const& chunk : shadowChunks)
+        compiledLevel.FillBatch(compiledLevel.ShadowCasters.EmplaceBack(), "shadow_caster", -1, chunk.Vertices, chunk.Indices);
+
+    CreateSectorGraph(compiledLevel);
+
+    {
+        ScopedPhaseTimer pvsTimer(&m_Profile, LoadProfile::PHASE_PVS);
+
+        SectorPVS::Compute(compiledLevel);
+    }
+    return true;
+}
+
+void BladeLevel::CreateSectorGraph(CompiledLevel& compiledLevel)
+{
+    int32_t sectorCount = bw.m_Sectors.Size();
+
+    compiledLevel.Sectors.Resize(sectorCount);
+
+    for (int32_t sectorIndex = 0; sectorIndex < sectorCount; ++sectorIndex)
+    {
+        BladeWorld::Sector const& sector = bw.m_Sectors[sectorIndex];
+        CompiledLevel::Sector& compiledSector = compiledLevel.Sectors[sectorIndex];
+
+        compiledSector.Bounds.Clear();
+        compiledSector.FirstPvsByte = 0;
+        compiledSector.PvsByteCount = 0;
+
+        Float3 center(0.0f);
+        uint32_t pointCount = 0;
+        for (uint32_t faceNum = 0; faceNum < sector.FaceCount; ++faceNum)
+        {
+            for (uint32_t index : bw.GetWinding(bw.m_Faces[sector.FirstFace + faceNum]))
             {
-                auto& v = vertexBuffer[k];
-                v.Position = transformMatrix * Float3(resultVertices[k].X, resultVertices[k].Y, plane.GetDist());
-                v.SetNormal(faceNormal);
+                Float3 position = ConvertCoord(Float3(bw.m_Vertices[index]));
+                compiledSector.Bounds.AddPoint(position);
+                center += position;
+                ++pointCount;
             }
+        }
+        if (pointCount)
+            center /= float(pointCount);
 
-            CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256);
+        // Sector faces bound a convex volume. Orient their planes so that the sector is on the front side.
+        compiledSector.FirstPlane = compiledLevel.SectorPlanes.Size();
+        for (uint32_t faceNum = 0; faceNum < sector.FaceCount; ++faceNum)
+        {
+            PlaneD facePlane = ConvertPlane(bw.m_Planes[bw.m_Faces[sector.FirstFace + faceNum].PlaneNum]);
 
-            for (auto& v : vertexBuffer)
-                v.Position = ConvertCoord(v.Position);
+            PlaneF plane;
+            plane.Normal = Float3(facePlane.Normal);
+            plane.D = float(facePlane.D);
+            if (plane.DistanceToPoint(center) < 0)
+            {
+                plane.Normal = -plane.Normal;
+                plane.D = -plane.D;
+            }
 
-            //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
+            bool duplicate = false;
+            for (uint32_t i = compiledSector.FirstPlane; i < compiledLevel.SectorPlanes.Size() && !duplicate; ++i)
+            {
+                PlaneF const& other = compiledLevel.SectorPlanes[i];
+                duplicate = Math::Dot(other.Normal, plane.Normal) > 0.9999f && Math::Abs(other.D - plane.D) < 0.0001f;
+            }
+            if (!duplicate)
+                compiledLevel.SectorPlanes.Add(plane);
         }
-        else if (face.Type == BladeWorld::FT_MULTIPLE_PORTALS)
+        compiledSector.PlaneCount = compiledLevel.SectorPlanes.Size() - compiledSector.FirstPlane;
+
+        compiledSector.FirstPortal = compiledLevel.Portals.Size();
+        for (uint32_t portalNum = 0; portalNum < sector.PortalCount; ++portalNum)
         {
-            PlaneD plane = bw.m_Planes[face.PlaneNum];
+            BladeWorld::Portal const& portal = bw.m_Portals[sector.FirstPortal + portalNum];
+            if (portal.ToSector < 0 || portal.ToSector >= sectorCount || portal.Winding.Count < 3)
+                continue;
+
+            CompiledLevel::Portal& compiledPortal = compiledLevel.Portals.EmplaceBack();
+            compiledPortal.ToSector = portal.ToSector;
+            compiledPortal.FirstVertex = compiledLevel.PortalVertices.Size();
+            compiledPortal.VertexCount = portal.Winding.Count;
+            for (uint32_t i = 0; i < portal.Winding.Count; ++i)
+                compiledLevel.PortalVertices.Add(ConvertCoord(Float3(bw.m_Vertices[bw.m_Indices[portal.Winding.First + i]])));
+        }
+        compiledSector.PortalCount = compiledLevel.Portals.Size() - compiledSector.FirstPortal;
+    }
+}
 
-            Vector<Double3> winding = CreateWinding(bw.m_Vertices, face.Winding);
+Vector<LevelGeometryChunk> BladeLevel::CreateChunks(Vector<Vector<MeshVertex>> const& vertexBatches, Vector<Vector<uint32_t>> const& indexBatches, Vector<Vector<int32_t>> const& sectorBatches)
+{
+    ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_CHUNKING);
 
-            CreateWindings_r(vertexBuffer, indexBuffer, face, winding, face.pRoot, nullptr);
+    Vector<Vector<LevelGeometryChunk>> textureChunks(vertexBatches.Size());
 
-#if 0
-            PolyClipper clipper;
-            clipper.SetTransformFromNormal(Float3(plane.Normal));
-            clipper.AddSubj3D(winding.ToPtr(), winding.Size());
+    ParallelFor(vertexBatches.Size(), [&](size_t textureNum)
+        {
+            if (!vertexBatches[textureNum].IsEmpty())
+                SplitIntoChunks(textureNum, vertexBatches[textureNum], indexBatches[textureNum], sectorBatches[textureNum], ChunkCellSize, textureChunks[textureNum]);
+        });
 
-            for (auto& h : face.Holes)
-            {
-                Vector<Double3> hole = CreateWinding(bw.m_Vertices, h);
-                clipper.AddClip3D(hole.ToPtr(), hole.Size());
-            }
+    Vector<LevelGeometryChunk> chunks;
+    for (auto& list : textureChunks)
+    {
+        for (auto& chunk : list)
+            chunks.Add(std::move(chunk));
+    }
+
+    uint64_t triangleCount = 0;
+    for (auto const& chunk : chunks)
+        triangleCount += chunk.Indices.Size() / 3;
+
+    m_Profile.Increment(LoadProfile::COUNTER_CHUNKS, chunks.Size());
+
+    if (!chunks.IsEmpty())
+        LOG("Level geometry split into {} chunks, {} triangles per chunk on average\n", chunks.Size(), double(triangleCount) / chunks.Size());
+
+    return chunks;
+}
+
+Vector<LevelGeometryChunk> BladeLevel::CreateShadowChunks(Vector<MeshVertex> const& vertices, Vector<uint32_t> const& indices)
+{
+    ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_CHUNKING);
+
+    Vector<LevelGeometryChunk> chunks;
+    if (indices.IsEmpty())
+        return chunks;
+
+    // Shadows of hidden sectors still reach visible ones, so the regions are not bound to sectors
+    Vector<int32_t> triangleSectors(indices.Size() / 3, -1);
+
+    SplitIntoChunks(-1, vertices, indices, triangleSectors, ShadowChunkCellSize, chunks);
+
+    m_Profile.Increment(LoadProfile::COUNTER_SHADOW_CHUNKS, chunks.Size());
+
+    LOG("Level shadow caster split into {} regions\n", chunks.Size());
+
+    return chunks;
+}
+
+void BladeLevel::OptimizeBatches(Vector<LevelGeometryChunk>& chunks, Vector<LevelGeometryChunk>& shadowChunks,
+    Vector<MeshVertex>& skydomeVertexBuffer, Vector<uint32_t>& skydomeIndexBuffer)
+{
+    ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_MESH_OPTIMIZE);
+
+    struct BatchRef
+    {
+        Vector<MeshVertex>* Vertices;
+        Vector<uint32_t>* Indices;
+        MeshOptimizer::Stats Stats;
+    };
+
+    Vector<BatchRef> batches;
+    for (auto& chunk : chunks)
+        batches.Add({&chunk.Vertices, &chunk.Indices});
+    for (auto& chunk : shadowChunks)
+        batches.Add({&chunk.Vertices, &chunk.Indices});
+    batches.Add({&skydomeVertexBuffer, &skydomeIndexBuffer});
+
+    ParallelFor(batches.Size(), [&](size_t i)
+        {
+            batches[i].Stats = MeshOptimizer::Optimize(*batches[i].Vertices, *batches[i].Indices);
+        });
+
+    uint64_t verticesBefore = 0;
+    uint64_t verticesAfter = 0;
+    double missesBefore = 0;
+    double missesAfter = 0;
+    uint64_t triangleCount = 0;
+    for (BatchRef const& batch : batches)
+    {
+        uint32_t batchTriangles = batch.Indices->Size() / 3;
+
+        verticesBefore += batch.Stats.VerticesBefore;
+        verticesAfter += batch.Stats.VerticesAfter;
+        missesBefore += batch.Stats.ACMRBefore * batchTriangles;
+        missesAfter += batch.Stats.ACMRAfter * batchTriangles;
+        triangleCount += batchTriangles;
+    }
+
+    m_Profile.Increment(LoadProfile::COUNTER_VERTICES_BEFORE_OPTIMIZE, verticesBefore);
+    m_Profile.Increment(LoadProfile::COUNTER_VERTICES_AFTER_OPTIMIZE, verticesAfter);
+
+    if (triangleCount)
+        LOG("Level batches optimized: {} -> {} vertices, ACMR {} -> {}\n", verticesBefore, verticesAfter, missesBefore / triangleCount, missesAfter / triangleCount);
+}
+
+void BladeLevel::CreateWorldMeshes(CompiledLevel const& compiledLevel)
+{
+    auto& materialMngr = GameApplication::sGetMaterialManager();
+
+    GameObjectDesc desc;
+    GameObject* object;
+    m_World->CreateObject(desc, object);
+
+    // Чанки строятся по секторам, видимость секторов определяется порталами в UpdateVisibility.
+
+    ScopedPhaseTimer uploadTimer(&m_Profile, LoadProfile::PHASE_MESH_UPLOAD);
+
+    m_PortalCulling.Initialize(compiledLevel);
+
+    m_SectorMeshes.Clear();
+    m_SectorMeshes.Resize(compiledLevel.Sectors.Size());
+    m_SectorShown.Clear();
+    m_SectorShown.Resize(compiledLevel.Sectors.Size());
+    for (uint8_t& shown : m_SectorShown)
+        shown = 1;
+
+    auto createMesh = [&](CompiledLevel::Batch const& batch) -> StaticMeshComponent*
+        {
+            const MeshVertex* vertices = compiledLevel.Vertices.ToPtr() + batch.FirstVertex;
+            const uint32_t* indices = compiledLevel.Indices.ToPtr() + batch.FirstIndex;
+
+            m_Profile.AddBatch(batch.TextureName, batch.VertexCount, batch.IndexCount);
+            m_Profile.Increment(LoadProfile::COUNTER_BYTES_UPLOADED, batch.VertexCount * sizeof(MeshVertex) + batch.IndexCount * sizeof(uint32_t));
+
+            MeshRef surface(new Mesh);
 
-            Vector<ClipperPolygon> resultPolygons;
-            clipper.MakeDiff(resultPolygons);
-
-            using MyTriangulator = Triangulator<Double2, Double2>;
-            Vector<Double2> resultVertices;
-            MyTriangulator triangulator(&resultVertices, &indexBuffer);
-            MyTriangulator::Polygon polygon;
-            polygon.Normal.X = 0;
-            polygon.Normal.Y = 0;
-            polygon.Normal.Z = 1;
-            for (int i = 0; i < resultPolygons.Size(); i++)
-            {
-                polygon.OuterContour = resultPolygons[i].Outer.ToPtr();
-                polygon.OuterContourVertexCount = resultPolygons[i].Outer.Size();
+            MeshAllocateDesc alloc;
+            alloc.SurfaceCount = 1;
+            alloc.VertexCount = batch.VertexCount;
+            alloc.IndexCount = batch.IndexCount;
 
-                polygon.HoleContours.Resize(resultPolygons[i].Holes.Size());
-                for (int j = 0; j < resultPolygons[i].Holes.Size(); j++)
-                    polygon.HoleContours[j] = std::make_pair(resultPolygons[i].Holes[j].ToPtr(), resultPolygons[i].Holes[j].Size());
+            surface->Allocate(alloc);
+            surface->WriteVertexData(vertices, batch.VertexCount, 0);
+            surface->WriteIndexData(indices, batch.IndexCount, 0);
+            surface->SetBoundingBox(batch.Bounds);
 
-                triangulator.Triangulate(&polygon);
-            }    
+            MeshSurface& meshSurface = surface->LockSurface(0);
+            meshSurface.BoundingBox = batch.Bounds;
 
-            const Float3x3& transformMatrix = clipper.GetTransform();
+            StaticMeshComponent* mesh;
+            Handle32<StaticMeshComponent> handle = object->CreateComponent(mesh);
+            mesh->SetMesh(surface);
+            mesh->SetLocalBoundingBox(batch.Bounds);
 
-            vertexBuffer.Resize(resultVertices.Size());
-            for (int k = 0; k < resultVertices.Size(); k++)
-            {
-                auto& v = vertexBuffer[k];
-                v.Position = transformMatrix * Float3(resultVertices[k].X, resultVertices[k].Y, plane.GetDist());
-                v.SetNormal(faceNormal);
-            }
+            if (batch.Sector >= 0)
+                m_SectorMeshes[batch.Sector].Add(handle);
+            return mesh;
+        };
 
-            CalcTextureCoorinates(&face, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256);
+    for (auto const& batch : compiledLevel.Batches)
+    {
+        StaticMeshComponent* mesh = createMesh(batch);
+        mesh->SetCastShadow(false);
+        mesh->SetMaterial(FindMaterial(batch.TextureName));
+    }
 
-            for (auto& v : vertexBuffer)
-                v.Position = ConvertCoord(v.Position);
+    // Skydome
+    if (compiledLevel.Skydome.VertexCount > 0)
+    {
+        StaticMeshComponent* mesh = createMesh(compiledLevel.Skydome);
+        mesh->SetCastShadow(false);
+        mesh->SetMaterial(materialMngr.FindMaterial("skywall"));
+    }
 
-            //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
-#endif
+    // Level shadow caster, one mesh per region so the cascades cull them by bounds
+    MatInstanceRef shadowMaterial = materialMngr.FindMaterial("shadow_caster");
+    for (auto const& batch : compiledLevel.ShadowCasters)
+    {
+        StaticMeshComponent* mesh = createMesh(batch);
+        mesh->SetShadowMode(ShadowMode::CastOnlyShadow);
+        mesh->SetMaterial(shadowMaterial);
+    }
+}
 
+void BladeLevel::UpdateVisibility(Float3 const& viewPosition, const PlaneF* frustumPlanes, int frustumPlaneCount)
+{
+    if (m_PortalCullingEnabled)
+        m_PortalCulling.Update(viewPosition, frustumPlanes, frustumPlaneCount);
 
-            //Vector<ClipperContour> Holes;
-
-            //int numHoles = face.Holes.Size();
-            //if (numHoles > 0)
-            //{
-            //    PolyClipper holesUnion;
-
-            //    holesUnion.SetTransformFromNormal(Float3(plane.Normal));
-            //    for (int c = 0; c < numHoles; c++)
-            //    {
-            //        Vector<Double3> hole = CreateWinding(bw.m_Vertices, face.Holes[c]);
-            //        holesUnion.AddSubj3D(hole.ToPtr(), hole.Size());
-            //    }
-
-            //    // FIXME: Union of hulls may produce inner holes!
-            //    holesUnion.MakeUnion(Holes);
-            //}
-
-            //// Create windings and fill Leafs
-            //CreateWindings_r(face, Holes, winding, face->pRoot);
-
-            //// Create subfaces
-            //for (int i = 0; i < m_Leafs.Size(); i++)
-            //{
-            //    if (m_Leafs[i]->Vertices.Size() > 0 && m_Leafs[i]->Indices.Size() > 0)
-            //    {
-            //        m_Leafs[i]->TextureNum = face->TextureNum;
-            //        m_Leafs[i]->TexCoordAxis[0] = face->TexCoordAxis[0];
-            //        m_Leafs[i]->TexCoordAxis[1] = face->TexCoordAxis[1];
-            //        m_Leafs[i]->TexCoordOffset[0] = face->TexCoordOffset[0];
-            //        m_Leafs[i]->TexCoordOffset[1] = face->TexCoordOffset[1];
-
-            //        FilterWinding_r(face, face->pRoot, m_Leafs[i]);
-
-            //        Face* SubFace = m_Faces[AllocateFaces(1)];
-            //        SubFace->Type = FT_SUBFACE;
-            //        SubFace->TextureNum = m_Leafs[i]->TextureNum;
-            //        SubFace->TexCoordAxis[0] = m_Leafs[i]->TexCoordAxis[0];
-            //        SubFace->TexCoordAxis[1] = m_Leafs[i]->TexCoordAxis[1];
-            //        SubFace->TexCoordOffset[0] = m_Leafs[i]->TexCoordOffset[0];
-            //        SubFace->TexCoordOffset[1] = m_Leafs[i]->TexCoordOffset[1];
-            //        SubFace->SectorIndex = face->SectorIndex;
-            //        SubFace->PlaneNum = face->PlaneNum;
-            //        SubFace->Vertices = m_Leafs[i]->Vertices;
-            //        SubFace->Indices = m_Leafs[i]->Indices;
-
-            //        face->SubFaces.Add(SubFace);
-            //    }
-            //    else
-            //    {
-            //        LOG("Leaf with no vertices\n");
-            //    }
-            //}
-            //m_Leafs.Clear();
-        }
-        else
-        {
+    for (int32_t sector = 0; sector < int32_t(m_SectorMeshes.Size()); ++sector)
+    {
+        uint8_t shown = !m_PortalCullingEnabled || m_PortalCulling.IsSectorVisible(sector);
+        if (m_SectorShown[sector] == shown)
             continue;
-        }
 
-        if (face.Type != BladeWorld::FT_SKYDOME && bw.m_TextureNames[face.TextureNum] != "blanca")
+        m_SectorShown[sector] = shown;
+
+        for (Handle32<StaticMeshComponent> handle : m_SectorMeshes[sector])
         {
-            // add vertexbuffer, indexbuffer to shadow caster
+            if (StaticMeshComponent* mesh = m_World->GetComponent(handle))
+                mesh->SetVisibilityLayer(shown ? 0 : HiddenLayer);
+        }
+    }
+}
 
-            uint32_t firstVertex = shadowVertexBuffer.Size();
+bool BladeLevel::CompileFace(BladeWorld::Face const& face, FaceScratch& scratch, Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer)
+{
+    PlaneD facePlane = ConvertPlane(bw.m_Planes[face.PlaneNum]);
+    Float3 faceNormal = Float3(facePlane.Normal);
 
-            shadowVertexBuffer.Add(vertexBuffer);
+    switch (face.Type)
+    {
+        case BladeWorld::FT_OPAQUE:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_OPAQUE);
+            break;
+        case BladeWorld::FT_TRANSPARENT:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_TRANSPARENT);
+            break;
+        case BladeWorld::FT_SINGLE_PORTAL:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_SINGLE_PORTAL);
+            break;
+        case BladeWorld::FT_MULTIPLE_PORTALS:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_MULTIPLE_PORTALS);
+            break;
+        case BladeWorld::FT_SKYDOME:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_SKYDOME);
+            break;
+        default:
+            m_Profile.Increment(LoadProfile::COUNTER_FACES_UNKNOWN);
+            break;
+    }
 
-            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
-            {
-                shadowIndexBuffer.Add(firstVertex + indexBuffer[i  ]);
-                shadowIndexBuffer.Add(firstVertex + indexBuffer[i+1]);
-                shadowIndexBuffer.Add(firstVertex + indexBuffer[i+2]);
-            }
-        }
+    if (face.Type == BladeWorld::FT_OPAQUE || face.Type == BladeWorld::FT_SKYDOME)
+    {
+        auto windingIndices = bw.GetWinding(face);
+        int windingSize = windingIndices.Size();
 
-        if (face.Type == BladeWorld::FT_SKYDOME)
+        for (int k = 0; k < windingSize; ++k)
         {
-            Vector<MeshVertex>& vertexBatch = skydomeVertexBuffer;
-            Vector<uint32_t>& indexBatch = skydomeIndexBuffer;
+            auto& v = vertexBuffer.EmplaceBack();
 
-            uint32_t firstVertex = vertexBatch.Size();
-            vertexBatch.Add(vertexBuffer);
-            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
-            {
-                indexBatch.Add(firstVertex + indexBuffer[i  ]);
-                indexBatch.Add(firstVertex + indexBuffer[i+1]);
-                indexBatch.Add(firstVertex + indexBuffer[i+2]);
-            }
+            v.Position = Float3(bw.m_Vertices[windingIndices[k]]);
+            v.SetNormal(faceNormal);
         }
-        else
-        {
-            Vector<MeshVertex>& vertexBatch = vertexBatches[face.TextureNum];
-            Vector<uint32_t>& indexBatch = indexBatches[face.TextureNum];
 
-            uint32_t firstVertex = vertexBatch.Size();
-            vertexBatch.Add(vertexBuffer);
-            for (uint32_t i = 0; i < indexBuffer.Size(); i += 3)
-            {
-                indexBatch.Add(firstVertex + indexBuffer[i  ]);
-                indexBatch.Add(firstVertex + indexBuffer[i+1]);
-                indexBatch.Add(firstVertex + indexBuffer[i+2]);
-            }
+        // triangle fan -> triangles
+        for (int j = 0; j < windingSize - 2; ++j)
+        {
+            indexBuffer.Add(0);
+            indexBuffer.Add(windingSize - j - 2);
+            indexBuffer.Add(windingSize - j - 1);
         }
-    }
 
-    // TODO:
-    // Разбить пространство на кубы, распределить треугольники каждого батча по кубам, получим чанки.
-    // Если треугольник попадает в несколько кубов, то определить его в тот куб, AABB которого будет меньше с учетом этого треугольника.
-    // Далее для каждого куба составить список чанков, AABB которых пересекается с кубом.
-    // Далее сделать препроцесс для проверки какой куб из какого куба будет виден, составить PVS.
-    // При рендере, получаем куб в котором находится камера, извлекаем PVS, из PVS получаем список видимых кубов, рисуем чанки, которые
-    // относятся к этим кубам.
-    // Для динамики, в рантайме определяем к какому кубу относится динамический меш, рисуем в зависимости от PVS.
+        CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256, scratch.Texcoords, &m_Profile);
 
-    // TODO:
-    // Использовать meshoptimizer для оптимизации геометрии
+        for (auto& v : vertexBuffer)
+            v.Position = ConvertCoord(v.Position);
 
-    for (int textureNum = 0; textureNum < bw.m_TextureNames.Size(); ++textureNum)
+        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
+    }
+    else if (face.Type == BladeWorld::FT_TRANSPARENT)
     {
-        const Vector<MeshVertex>& vertexBatch = vertexBatches[textureNum];
-        const Vector<uint32_t>& indexBatch = indexBatches[textureNum];
-
-        if (vertexBatch.IsEmpty())
-            continue;
+        // Do nothing
+        return false;
+    }
+    else if (face.Type == BladeWorld::FT_SINGLE_PORTAL)
+    {
+        PlaneD plane = bw.m_Planes[face.PlaneNum];
 
-        MeshRef surface(new Mesh);
+        if (scratch.Holes.Contours.IsEmpty())
+            scratch.Holes.Contours.Resize(1);
 
-        BvAxisAlignedBox bounds;
-        bounds.Clear();
-        for (auto& v : vertexBatch)
-            bounds.AddPoint(v.Position);
+        Vector<Double3>& winding = scratch.Winding;
+        Vector<Double3>& hole = scratch.Holes.Contours[0].Points;
 
-        MeshAllocateDesc alloc;
-        alloc.SurfaceCount = 1;
-        alloc.VertexCount = vertexBatch.Size();
-        alloc.IndexCount = indexBatch.Size();
+        CreateWinding(bw.m_Vertices, bw.GetWinding(face), winding);
+        CreateWinding(bw.m_Vertices, bw.GetHole(face, 0), hole);
 
-        surface->Allocate(alloc);
-        surface->WriteVertexData(vertexBatch.ToPtr(), vertexBatch.Size(), 0);
-        surface->WriteIndexData(indexBatch.ToPtr(), indexBatch.Size(), 0);
-        surface->SetBoundingBox(bounds);
+        const Vector<Double3>* holes[] = {&hole};
+        TriangulateFace(vertexBuffer, indexBuffer, scratch, winding, holes, 1, plane, faceNormal);
 
-        MeshSurface& meshSurface = surface->LockSurface(0);
-        meshSurface.BoundingBox = bounds;
+        CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256, scratch.Texcoords, &m_Profile);
 
-        StaticMeshComponent* mesh;
-        object->CreateComponent(mesh);
-        mesh->SetMesh(surface);
-        mesh->SetLocalBoundingBox(bounds);
-        mesh->SetCastShadow(false);
+        for (auto& v : vertexBuffer)
+            v.Position = ConvertCoord(v.Position);
 
-        mesh->SetMaterial(FindMaterial(bw.m_TextureNames[textureNum]));
+        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
     }
-
-    // Skydome
-    if (!skydomeVertexBuffer.IsEmpty())
+    else if (face.Type == BladeWorld::FT_MULTIPLE_PORTALS)
     {
-        const Vector<MeshVertex>& vertexBatch = skydomeVertexBuffer;
-        const Vector<uint32_t>& indexBatch = skydomeIndexBuffer;
+        PlaneD plane = bw.m_Planes[face.PlaneNum];
 
-        MeshRef surface(new Mesh);
+        CreateWinding(bw.m_Vertices, bw.GetWinding(face), scratch.Winding);
 
-        BvAxisAlignedBox bounds;
-        bounds.Clear();
-        for (auto& v : vertexBatch)
-            bounds.AddPoint(v.Position);
+        // Holes are the same for every leaf of the face, so they are built once
+        FaceHoles& holes = scratch.Holes;
+        GetPlaneAxes(plane.Normal, holes.AxisU, holes.AxisV);
+        if (holes.Contours.Size() < face.Holes.Count)
+            holes.Contours.Resize(face.Holes.Count);
+        holes.Count = face.Holes.Count;
+        for (uint32_t holeNum = 0; holeNum < holes.Count; ++holeNum)
+        {
+            HoleContour& contour = holes.Contours[holeNum];
+            CreateWinding(bw.m_Vertices, bw.GetHole(face, holeNum), contour.Points);
+            GetContourBounds(contour.Points, holes.AxisU, holes.AxisV, contour.Mins, contour.Maxs);
+        }
 
-        MeshAllocateDesc alloc;
-        alloc.SurfaceCount = 1;
-        alloc.VertexCount = vertexBatch.Size();
-        alloc.IndexCount = indexBatch.Size();
+        CreateWindings_r(vertexBuffer, indexBuffer, face, scratch, -1, 0, face.RootNode, nullptr);
 
-        surface->Allocate(alloc);
-        surface->WriteVertexData(vertexBatch.ToPtr(), vertexBatch.Size(), 0);
-        surface->WriteIndexData(indexBatch.ToPtr(), indexBatch.Size(), 0);
-        surface->SetBoundingBox(bounds);
+#if 0
+        PolyClipper clipper;
+        clipper.SetTransformFromNormal(Float3(plane.Normal));
+        clipper.AddSubj3D(winding.ToPtr(), winding.Size());
 
-        MeshSurface& meshSurface = surface->LockSurface(0);
-        meshSurface.BoundingBox = bounds;
+        for (auto& h : face.Holes)
+        {
+            Vector<Double3> hole = CreateWinding(bw.m_Vertices, h);
+            clipper.AddClip3D(hole.ToPtr(), hole.Size());
+        }
 
-        StaticMeshComponent* mesh;
-        object->CreateComponent(mesh);
-        mesh->SetMesh(surface);
-        mesh->SetLocalBoundingBox(bounds);
-        mesh->SetCastShadow(false);
+        Vector<ClipperPolygon> resultPolygons;
+        clipper.MakeDiff(resultPolygons);
 
-        mesh->SetMaterial(skyMaterial);
-    }
+        using MyTriangulator = Triangulator<Double2, Double2>;
+        Vector<Double2> resultVertices;
+        MyTriangulator triangulator(&resultVertices, &indexBuffer);
+        MyTriangulator::Polygon polygon;
+        polygon.Normal.X = 0;
+        polygon.Normal.Y = 0;
+        polygon.Normal.Z = 1;
+        for (int i = 0; i < resultPolygons.Size(); i++)
+        {
+            polygon.OuterContour = resultPolygons[i].Outer.ToPtr();
+            polygon.OuterContourVertexCount = resultPolygons[i].Outer.Size();
 
-    // Create level shadow caster
-    {
-        MeshRef surface(new Mesh);
+            polygon.HoleContours.Resize(resultPolygons[i].Holes.Size());
+            for (int j = 0; j < resultPolygons[i].Holes.Size(); j++)
+                polygon.HoleContours[j] = std::make_pair(resultPolygons[i].Holes[j].ToPtr(), resultPolygons[i].Holes[j].Size());
+
+            triangulator.Triangulate(&polygon);
+        }    
 
-        BvAxisAlignedBox bounds;
-        bounds.Clear();
-        for (auto& v : shadowVertexBuffer)
-            bounds.AddPoint(v.Position);
+        const Float3x3& transformMatrix = clipper.GetTransform();
 
-        MeshAllocateDesc alloc;
-        alloc.SurfaceCount = 1;
-        alloc.VertexCount = shadowVertexBuffer.Size();
-        alloc.IndexCount = shadowIndexBuffer.Size();
+        vertexBuffer.Resize(resultVertices.Size());
+        for (int k = 0; k < resultVertices.Size(); k++)
+        {
+            auto& v = vertexBuffer[k];
+            v.Position = transformMatrix * Float3(resultVertices[k].X, resultVertices[k].Y, plane.GetDist());
+            v.SetNormal(faceNormal);
+        }
 
-        surface->Allocate(alloc);
-        surface->WriteVertexData(shadowVertexBuffer.ToPtr(), shadowVertexBuffer.Size(), 0);
-        surface->WriteIndexData(shadowIndexBuffer.ToPtr(), shadowIndexBuffer.Size(), 0);
-        surface->SetBoundingBox(bounds);
+        CalcTextureCoorinates(&face, vertexBuffer.ToPtr(), vertexBuffer.Size(), 256, 256);
 
-        MeshSurface& meshSurface = surface->LockSurface(0);
-        meshSurface.BoundingBox = bounds;
+        for (auto& v : vertexBuffer)
+            v.Position = ConvertCoord(v.Position);
 
-        StaticMeshComponent* mesh;
-        object->CreateComponent(mesh);
-        mesh->SetMesh(surface);
-        mesh->SetLocalBoundingBox(bounds);
-        mesh->SetShadowMode(ShadowMode::CastOnlyShadow);
+        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr(), indexBuffer.ToPtr(), indexBuffer.Size());
+#endif
+
+
+        //Vector<ClipperContour> Holes;
+
+        //int numHoles = face.Holes.Size();
+        //if (numHoles > 0)
+        //{
+        //    PolyClipper holesUnion;
+
+        //    holesUnion.SetTransformFromNormal(Float3(plane.Normal));
+        //    for (int c = 0; c < numHoles; c++)
+        //    {
+        //        Vector<Double3> hole = CreateWinding(bw.m_Vertices, face.Holes[c]);
+        //        holesUnion.AddSubj3D(hole.ToPtr(), hole.Size());
+        //    }
+
+        //    // FIXME: Union of hulls may produce inner holes!
+        //    holesUnion.MakeUnion(Holes);
+        //}
 
-        mesh->SetMaterial(materialMngr.FindMaterial("shadow_caster"));
+        //// Create windings and fill Leafs
+        //CreateWindings_r(face, Holes, winding, face->pRoot);
+
+        //// Create subfaces
+        //for (int i = 0; i < m_Leafs.Size(); i++)
+        //{
+        //    if (m_Leafs[i]->Vertices.Size() > 0 && m_Leafs[i]->Indices.Size() > 0)
+        //    {
+        //        m_Leafs[i]->TextureNum = face->TextureNum;
+        //        m_Leafs[i]->TexCoordAxis[0] = face->TexCoordAxis[0];
+        //        m_Leafs[i]->TexCoordAxis[1] = face->TexCoordAxis[1];
+        //        m_Leafs[i]->TexCoordOffset[0] = face->TexCoordOffset[0];
+        //        m_Leafs[i]->TexCoordOffset[1] = face->TexCoordOffset[1];
+
+        //        FilterWinding_r(face, face->pRoot, m_Leafs[i]);
+
+        //        Face* SubFace = m_Faces[AllocateFaces(1)];
+        //        SubFace->Type = FT_SUBFACE;
+        //        SubFace->TextureNum = m_Leafs[i]->TextureNum;
+        //        SubFace->TexCoordAxis[0] = m_Leafs[i]->TexCoordAxis[0];
+        //        SubFace->TexCoordAxis[1] = m_Leafs[i]->TexCoordAxis[1];
+        //        SubFace->TexCoordOffset[0] = m_Leafs[i]->TexCoordOffset[0];
+        //        SubFace->TexCoordOffset[1] = m_Leafs[i]->TexCoordOffset[1];
+        //        SubFace->SectorIndex = face->SectorIndex;
+        //        SubFace->PlaneNum = face->PlaneNum;
+        //        SubFace->Vertices = m_Leafs[i]->Vertices;
+        //        SubFace->Indices = m_Leafs[i]->Indices;
+
+        //        face->SubFaces.Add(SubFace);
+        //    }
+        //    else
+        //    {
+        //        LOG("Leaf with no vertices\n");
+        //    }
+        //}
+        //m_Leafs.Clear();
+    }
+    else
+    {
+        return false;
     }
+
+    m_Profile.Increment(LoadProfile::COUNTER_TRIANGLES, indexBuffer.Size() / 3);
+    m_Profile.Increment(LoadProfile::COUNTER_VERTICES, vertexBuffer.Size());
+    return true;
 }
 #if 0
 void BladeLevel::ReadMultiplePortalsFace(File& file, Face* face)
@@ -1132,35 +2150,78 @@ PlaneSide SplitWinding(Vector<Double3> const& winding, PlaneD const& plane, doub
     return PlaneSide::Cross;
 }
 
-void BladeLevel::CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer,
-    BladeWorld::Face const& face, Vector<Double3> const& winding, BladeWorld::BSPNode const* node, BladeWorld::BSPNode const* texInfo)
+void BladeLevel::TriangulateFace(Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer, FaceScratch& scratch,
+    Vector<Double3> const& winding, const Vector<Double3>* const* holes, uint32_t holeCount, PlaneD const& plane, Float3 const& faceNormal)
 {
-    if (node->Type == BladeWorld::NT_TEXINFO)
+    uint32_t firstVertex = vertexBuffer.Size();
+
+    // Most windings and holes are convex, they don't need the full polygon boolean
     {
-        texInfo = node;
-#if 0
-        PlaneD plane = bw.m_Planes[face.PlaneNum];
+        CONVEX_TRIANGULATION result;
+        {
+            ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_TRIANGULATE);
 
-        PlaneD facePlane = ConvertPlane(plane);
-        Float3 faceNormal = Float3(facePlane.Normal);
+            result = TriangulateConvex(winding, holes, holeCount, plane.Normal, scratch.Convex);
+        }
 
-        PolyClipper clipper;
-        clipper.SetTransformFromNormal(Float3(plane.Normal));
-        clipper.AddSubj3D(winding.ToPtr(), winding.Size());
+        switch (result)
+        {
+            case CT_POLYGON:
+                m_Profile.Increment(LoadProfile::COUNTER_TRIANGULATE_CONVEX);
+                break;
+            case CT_RING:
+                m_Profile.Increment(LoadProfile::COUNTER_TRIANGULATE_CONVEX_RING);
+                break;
+            case CT_COVERED:
+                m_Profile.Increment(LoadProfile::COUNTER_TRIANGULATE_COVERED);
+                return;
+            default:
+                break;
+        }
 
-        for (auto& h : face.Holes)
+        if (result != CT_FAILED)
         {
-            Vector<Double3> hole = CreateWinding(bw.m_Vertices, h);
-            clipper.AddClip3D(hole.ToPtr(), hole.Size());
+            for (Double3 const& position : scratch.Convex.Vertices)
+            {
+                auto& v = vertexBuffer.EmplaceBack();
+                v.Position = Float3(position);
+                v.SetNormal(faceNormal);
+            }
+
+            for (uint32_t index : scratch.Convex.Indices)
+                indexBuffer.Add(firstVertex + index);
+            return;
         }
+    }
+
+    m_Profile.Increment(LoadProfile::COUNTER_TRIANGULATE_CLIPPER);
+
+    PolyClipper clipper;
+    Vector<ClipperPolygon>& resultPolygons = scratch.ClipperPolygons;
+    {
+        ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_CLIP);
+
+        resultPolygons.Clear();
+
+        clipper.SetTransformFromNormal(Float3(plane.Normal));
+        clipper.AddSubj3D(winding.ToPtr(), winding.Size());
+
+        for (uint32_t holeNum = 0; holeNum < holeCount; ++holeNum)
+            clipper.AddClip3D(holes[holeNum]->ToPtr(), holes[holeNum]->Size());
 
-        Vector<ClipperPolygon> resultPolygons;
         clipper.MakeDiff(resultPolygons);
+    }
 
-        Vector<uint32_t> tempIndexBuffer;
+    Vector<uint32_t>& tempIndexBuffer = scratch.TriangulatorIndices;
+
+    using MyTriangulator = Triangulator<Double2, Double2>;
+    Vector<Double2>& resultVertices = scratch.TriangulatorVertices;
+    {
+        ScopedPhaseTimer timer(&m_Profile, LoadProfile::PHASE_TRIANGULATE);
+
+        resultVertices.Clear();
+        tempIndexBuffer.Clear();
 
-        using MyTriangulator = Triangulator<Double2, Double2>;
-        Vector<Double2> resultVertices;
         MyTriangulator triangulator(&resultVertices, &tempIndexBuffer);
         MyTriangulator::Polygon polygon;
         polygon.Normal.X = 0;
@@ -1177,33 +2238,34 @@ void BladeLevel::CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint3
 
             triangulator.Triangulate(&polygon);
         }
+    }
 
-        const Float3x3& transformMatrix = clipper.GetTransform();
-
-        uint32_t firstVertex = vertexBuffer.Size();
+    const Float3x3& transformMatrix = clipper.GetTransform();
 
-        for (int k = 0; k < resultVertices.Size(); k++)
-        {
-            auto& v = vertexBuffer.EmplaceBack();
-            v.Position = transformMatrix * Float3(resultVertices[k].X, resultVertices[k].Y, plane.GetDist());
-            v.SetNormal(faceNormal);
-        }
+    for (int k = 0; k < resultVertices.Size(); k++)
+    {
+        auto& v = vertexBuffer.EmplaceBack();
+        v.Position = transformMatrix * Float3(resultVertices[k].X, resultVertices[k].Y, plane.GetDist());
+        v.SetNormal(faceNormal);
+    }
 
-        CalcTextureCoorinates(node->TexCoordAxis, node->TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, resultVertices.Size(), 256, 256);
+    for (uint32_t index : tempIndexBuffer)
+        indexBuffer.Add(firstVertex + index);
+}
 
-        for (uint32_t i = 0; i < resultVertices.Size(); ++i)
-            vertexBuffer[firstVertex + i].Position = ConvertCoord(vertexBuffer[firstVertex + i].Position);
+void BladeLevel::CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer,
+    BladeWorld::Face const& face, FaceScratch& scratch, int32_t windingSlot, uint32_t depth, uint32_t nodeIndex, BladeWorld::BSPNode const* texInfo)
+{
+    m_Profile.Increment(LoadProfile::COUNTER_BSP_NODES_VISITED);
 
-        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr() + firstVertex, tempIndexBuffer.ToPtr(), tempIndexBuffer.Size());
+    FaceHoles const& holes = scratch.Holes;
 
-        for (uint32_t index : tempIndexBuffer)
-            indexBuffer.Add(firstVertex + index);
+    BladeWorld::BSPNode const* node = &bw.m_BSPNodes[nodeIndex];
 
-#endif
-    }
-    else if (node->Type == BladeWorld::NT_LEAF)
+    if (node->Type == BladeWorld::NT_TEXINFO)
     {
-#if 1
+        texInfo = node;
+#if 0
         PlaneD plane = bw.m_Planes[face.PlaneNum];
 
         PlaneD facePlane = ConvertPlane(plane);
@@ -1254,22 +2316,64 @@ void BladeLevel::CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint3
             v.SetNormal(faceNormal);
         }
 
+        CalcTextureCoorinates(node->TexCoordAxis, node->TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, resultVertices.Size(), 256, 256);
+
+        for (uint32_t i = 0; i < resultVertices.Size(); ++i)
+            vertexBuffer[firstVertex + i].Position = ConvertCoord(vertexBuffer[firstVertex + i].Position);
+
+        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr() + firstVertex, tempIndexBuffer.ToPtr(), tempIndexBuffer.Size());
+
+        for (uint32_t index : tempIndexBuffer)
+            indexBuffer.Add(firstVertex + index);
+
+#endif
+    }
+    else if (node->Type == BladeWorld::NT_LEAF)
+    {
+#if 1
+        PlaneD plane = bw.m_Planes[face.PlaneNum];
+
+        PlaneD facePlane = ConvertPlane(plane);
+        Float3 faceNormal = Float3(facePlane.Normal);
+
+        // Only holes that overlap the leaf fragment can cut it
+        Vector<Double3> const& winding = windingSlot < 0 ? scratch.Winding : scratch.Fragments[windingSlot];
+
+        Double2 mins, maxs;
+        GetContourBounds(winding, holes.AxisU, holes.AxisV, mins, maxs);
+
+        Vector<const Vector<Double3>*>& leafHoles = scratch.LeafHoles;
+        leafHoles.Clear();
+        for (uint32_t holeNum = 0; holeNum < holes.Count; ++holeNum)
+        {
+            HoleContour const& contour = holes.Contours[holeNum];
+            if (contour.Mins.X > maxs.X + ConvexEpsilon || contour.Maxs.X < mins.X - ConvexEpsilon ||
+                contour.Mins.Y > maxs.Y + ConvexEpsilon || contour.Maxs.Y < mins.Y - ConvexEpsilon)
+                continue;
+            leafHoles.Add(&contour.Points);
+        }
+
+        m_Profile.Increment(LoadProfile::COUNTER_LEAF_HOLES_SKIPPED, holes.Count - leafHoles.Size());
+
+        uint32_t firstVertex = vertexBuffer.Size();
+
+        TriangulateFace(vertexBuffer, indexBuffer, scratch, winding, leafHoles.ToPtr(), leafHoles.Size(), plane, faceNormal);
+
+        uint32_t vertexCount = vertexBuffer.Size() - firstVertex;
+
         if (texInfo)
         {
-            CalcTextureCoorinates(texInfo->TexCoordAxis, texInfo->TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, resultVertices.Size(), 256, 256);
+            CalcTextureCoorinates(texInfo->TexCoordAxis, texInfo->TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, vertexCount, 256, 256, scratch.Texcoords, &m_Profile);
         }
         else
         {
-            CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, resultVertices.Size(), 256, 256);
+            CalcTextureCoorinates(face.TexCoordAxis, face.TexCoordOffset, vertexBuffer.ToPtr() + firstVertex, vertexCount, 256, 256, scratch.Texcoords, &m_Profile);
         }
 
-        for (uint32_t i = 0; i < resultVertices.Size(); ++i)
+        for (uint32_t i = 0; i < vertexCount; ++i)
             vertexBuffer[firstVertex + i].Position = ConvertCoord(vertexBuffer[firstVertex + i].Position);
 
-        for (uint32_t index : tempIndexBuffer)
-            indexBuffer.Add(firstVertex + index);
-
-        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr() + firstVertex, tempIndexBuffer.ToPtr(), tempIndexBuffer.Size());
+        //Geometry::CalcTangentSpace(vertexBuffer.ToPtr() + firstVertex, indexBuffer.ToPtr(), indexBuffer.Size());
 
 #endif
         //HK_ASSERT(!winding.IsEmpty());
@@ -1319,14 +2423,20 @@ void BladeLevel::CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint3
         return;
     }
 
-    Vector<Double3> front;
-    Vector<Double3> back;
+    // The fragments of a depth are written once both parents' subtrees are done with them.
+    // Slots are resized before any reference into them is taken.
+    uint32_t frontSlot = depth * 2;
+    uint32_t backSlot = depth * 2 + 1;
+    if (scratch.Fragments.Size() <= backSlot)
+        scratch.Fragments.Resize(backSlot + 1);
+
+    Vector<Double3> const& winding = windingSlot < 0 ? scratch.Winding : scratch.Fragments[windingSlot];
 
     HK_ASSERT(!winding.IsEmpty());
-    SplitWinding(winding, bw.m_Planes[node->PlaneNum], 0.0, front, back);
+    SplitWinding(winding, bw.m_Planes[node->PlaneNum], 0.0, scratch.Fragments[frontSlot], scratch.Fragments[backSlot]);
 
-    CreateWindings_r(vertexBuffer, indexBuffer, face, front, node->Children[0], texInfo);
-    CreateWindings_r(vertexBuffer, indexBuffer, face, back, node->Children[1], texInfo);
+    CreateWindings_r(vertexBuffer, indexBuffer, face, scratch, frontSlot, depth + 1, node->Children[0], texInfo);
+    CreateWindings_r(vertexBuffer, indexBuffer, face, scratch, backSlot, depth + 1, node->Children[1], texInfo);
 }
 
 #if 0
@@ -1368,9 +2478,38 @@ void BladeLevel::FilterWinding_r(Face* face, BSPNode* node, BSPNode* leaf)
 
 MatInstanceRef BladeLevel::FindMaterial(StringView name)
 {
-    auto it = m_Materials.Find(name);
-    if (it != m_Materials.End())
-        return it->second;
+    return FindMaterial(NameTable::Find(name));
+}
+
+MatInstanceRef BladeLevel::FindMaterial(NameAtom atom)
+{
+    auto it = m_TextureLookup.Find(atom);
+    if (it != m_TextureLookup.End())
+    {
+        AddTextureUser(it->second, atom);
+
+        TextureEntry& entry = m_TextureEntries[it->second];
+        if (entry.Material)
+            return entry.Material;
+
+        // Textures that were not prefetched are decoded on first use
+        if (!entry.Loaded)
+        {
+            Vector<uint32_t> textureEntries;
+            textureEntries.Add(it->second);
+            DecodeTextures(textureEntries);
+        }
+
+        if (entry.Texture)
+        {
+            auto& resourceMngr = GameApplication::sGetResourceManager();
+
+            entry.Material = MatInstanceRef(new MatInstance);
+            entry.Material->SetResource(resourceMngr.Acquire<Material>("/Root/materials/compiled/wall.mat"));
+            entry.Material->SetTexture(0, entry.Texture);
+            return entry.Material;
+        }
+    }
 
     //HK_ASSERT(0);
 
@@ -1388,7 +2527,7 @@ void BladeLevel::DrawDebug(DebugRenderer& renderer)
         for (int faceIndex=0;faceIndex<sector.FaceCount;++faceIndex)
         {
             contour.Clear();
-            for (uint32_t index : bw.m_Faces[sector.FirstFace + faceIndex].Winding)
+            for (uint32_t index : bw.GetWinding(bw.m_Faces[sector.FirstFace + faceIndex]))
             {
                 contour.Add(ConvertCoord(Float3(bw.m_Vertices[index])));
             }
@@ -30,35 +30,154 @@ SOFTWARE.
 
 #include <Hork/Resources/Texture.h>
 #include <Hork/Runtime/World/World.h>
+#include <Hork/Runtime/World/Modules/Render/Components/MeshComponent.h>
 #include <Hork/Geometry/BV/BvAxisAlignedBox.h>
 #include <Hork/Math/Plane.h>
 #include <Hork/Geometry/PolyClipper.h>
 #include <Hork/Geometry/VertexFormat.h>
 #include <Hork/Runtime/Materials/MatInstance.h>
 #include "DataFormats/BW.h"
+#include "DataFormats/CompiledLevel.h"
+#include "DataFormats/CompressedTexturePack.h"
+#include "DataFormats/MMP.h"
+#include "Utils/LoadProfile.h"
+#include "Utils/PortalCulling.h"
 
 using namespace Hk;
 
+// Part of a texture batch that lies in one sector and one cell of the level grid
+struct LevelGeometryChunk
+{
+    int32_t TextureNum;
+    int32_t Sector;
+    Vector<MeshVertex> Vertices;
+    Vector<uint32_t> Indices;
+};
+
 class BladeLevel
 {
 public:
+    // Meshes of culled sectors are moved to this visibility layer. Render views must exclude it from their visibility mask.
+    static constexpr uint8_t HiddenLayer = 31;
+
     void Load(World* world, StringView name);
 
+    // Shows level meshes of the sectors visible through portals from the view position and hides the rest.
+    // Call it once per frame before rendering.
+    void UpdateVisibility(Float3 const& viewPosition, const PlaneF* frustumPlanes, int frustumPlaneCount);
+
+    // When disabled, all sectors are drawn
+    void SetPortalCulling(bool enabled) { m_PortalCullingEnabled = enabled; }
+
+    // Use the precomputed sector PVS instead of flooding portals every frame
+    void SetUsePVS(bool usePVS) { m_PortalCulling.SetUsePVS(usePVS); }
+
+    // Sector queries for lights and objects placed in the level
+    int32_t FindSector(Float3 const& position) const { return m_PortalCulling.FindSector(position); }
+    bool IsSectorVisible(int32_t sector) const { return !m_PortalCullingEnabled || m_PortalCulling.IsSectorVisible(sector); }
+
+    PortalCulling const& GetPortalCulling() const { return m_PortalCulling; }
+
     void DrawDebug(DebugRenderer& renderer);
 
+    // Compiled level geometry and compressed textures are cached in this directory. An empty string disables the cache.
+    void SetCacheDirectory(StringView directory) { m_CacheDirectory = directory; }
+
+    // Starts a new load profile. The profile covers everything loaded until the end of the next Load, including
+    // texture packs loaded before it, and its total time runs from this call.
+    void ResetLoadProfile(StringView name);
+
+    // Timings and counters since the last ResetLoadProfile
+    LoadProfile const& GetLoadProfile() const { return m_Profile; }
+
 private:
+    struct HoleContour
+    {
+        Vector<Double3> Points;
+        Double2 Mins;   // Bounds on the face plane
+        Double2 Maxs;
+    };
+
+    // Holes of a multiple portals face, shared by all its BSP leaves
+    struct FaceHoles
+    {
+        Double3 AxisU;
+        Double3 AxisV;
+        Vector<HoleContour> Contours;   // Never shrinks, only the first Count are used
+        uint32_t Count = 0;
+    };
+
+    // Buffers reused by a compiling thread from face to face, defined in Level.cpp
+    struct FaceScratch;
+
     void LoadDome(StringView fileName);
-public:void LoadTextures(StringView fileName);private:
+public:
+    // Indexes the textures of the packs. A texture is decoded the first time its material is needed.
+    void LoadTextures(StringView fileName);
+    void LoadTextures(Vector<String> const& fileNames);
+
+    // Decodes the textures on worker threads ahead of FindMaterial
+    void PrefetchTextures(Vector<NameAtom> const& textureAtoms);
+private:
+    void DecodeTextures(Vector<uint32_t> const& textureEntries);
+    // Counts the decode and upload saved when another name already requested the texture of the entry
+    void AddTextureUser(uint32_t entryIndex, NameAtom atom);
     void UnloadTextures();
     void LoadWorld(StringView fileName);
+    bool CompileWorld(StringView fileName, CompiledLevel& compiledLevel);
+    Vector<LevelGeometryChunk> CreateChunks(Vector<Vector<MeshVertex>> const& vertexBatches, Vector<Vector<uint32_t>> const& indexBatches, Vector<Vector<int32_t>> const& sectorBatches);
+    Vector<LevelGeometryChunk> CreateShadowChunks(Vector<MeshVertex> const& vertices, Vector<uint32_t> const& indices);
+    void CreateSectorGraph(CompiledLevel& compiledLevel);
+    void OptimizeBatches(Vector<LevelGeometryChunk>& chunks, Vector<LevelGeometryChunk>& shadowChunks,
+        Vector<MeshVertex>& skydomeVertexBuffer, Vector<uint32_t>& skydomeIndexBuffer);
+    void CreateWorldMeshes(CompiledLevel const& compiledLevel);
+    bool CompileFace(BladeWorld::Face const& face, FaceScratch& scratch, Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer);
+    // Appends the triangulated winding minus the holes. Positions are left in BW coordinates.
+    void TriangulateFace(Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer, FaceScratch& scratch,
+        Vector<Double3> const& winding, const Vector<Double3>* const* holes, uint32_t holeCount, PlaneD const& plane, Float3 const& faceNormal);
+    // The winding of the node is scratch.Fragments[windingSlot], or scratch.Winding for the root
     void CreateWindings_r(Vector<MeshVertex>& vertexBuffer, Vector<uint32_t>& indexBuffer,
-        BladeWorld::Face const& face, Vector<Double3> const& winding, BladeWorld::BSPNode const* node, BladeWorld::BSPNode const* texInfo);
-public:MatInstanceRef FindMaterial(StringView name);private:
+        BladeWorld::Face const& face, FaceScratch& scratch, int32_t windingSlot, uint32_t depth, uint32_t nodeIndex, BladeWorld::BSPNode const* texInfo);
+public:MatInstanceRef FindMaterial(StringView name);
+    MatInstanceRef FindMaterial(NameAtom atom);private:
 
     World* m_World;
     Float3 m_SkyColorAvg;
-    Vector<TextureRef> m_Textures;
-    StringHashMap<MatInstanceRef> m_Materials;
+
+    // MMP pack and its block compressed copy in the cache directory. The copy has no textures if there is no cache.
+    struct TexturePack
+    {
+        String FileName;
+        String CacheFileName;
+        CompressedTexturePack Compressed;
+    };
+
+    // Texture of a pack. Loaded is set once the texture has been decoded, or failed to.
+    struct TextureEntry
+    {
+        BladeMMP::TextureHeader Header;
+        uint32_t Pack;
+        uint32_t PackTexture;   // Index of the texture in the pack
+        TextureRef Texture;
+        MatInstanceRef Material;
+        Vector<NameAtom> Users; // Names that requested the texture so far
+        bool Loaded = false;
+    };
+
+    Vector<TexturePack> m_TexturePacks;
+    Vector<TextureEntry> m_TextureEntries;
+    HashMap<NameAtom, uint32_t> m_TextureLookup;    // The last pack with the name wins
+    HashMap<uint64_t, uint32_t> m_TextureDedup;     // Hash of the texture data and size to entry
 
     BladeWorld bw;
+
+    LoadProfile m_Profile;
+    std::chrono::steady_clock::time_point m_ProfileStart = std::chrono::steady_clock::now();
+
+    String m_CacheDirectory;
+
+    PortalCulling m_PortalCulling;
+    bool m_PortalCullingEnabled = true;
+    Vector<Vector<Handle32<StaticMeshComponent>>> m_SectorMeshes;
+    Vector<uint8_t> m_SectorShown;
 };
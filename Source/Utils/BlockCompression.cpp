@@ -0,0 +1,297 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "BlockCompression.h"
+
+#include <Hork/Core/Containers/Vector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Hk;
+
+namespace
+{
+    struct SRGBTable
+    {
+        float ToLinear[256];
+
+        SRGBTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                ToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+
+    const SRGBTable& GetSRGBTable()
+    {
+        static const SRGBTable table;
+        return table;
+    }
+
+    uint8_t LinearToSRGB(float c)
+    {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    uint16_t PackColor565(float r, float g, float b)
+    {
+        int r5 = std::clamp(int(r * 31.0f / 255.0f + 0.5f), 0, 31);
+        int g6 = std::clamp(int(g * 63.0f / 255.0f + 0.5f), 0, 63);
+        int b5 = std::clamp(int(b * 31.0f / 255.0f + 0.5f), 0, 31);
+        return static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+    }
+
+    void UnpackColor565(uint16_t color, int rgb[3])
+    {
+        int r5 = (color >> 11) & 31;
+        int g6 = (color >> 5) & 63;
+        int b5 = color & 31;
+        rgb[0] = (r5 << 3) | (r5 >> 2);
+        rgb[1] = (g6 << 2) | (g6 >> 4);
+        rgb[2] = (b5 << 3) | (b5 >> 2);
+    }
+
+    // Endpoints are the extremes of the block colors along their principal axis, inset a little to reduce the error
+    // of the interpolated colors. Each pixel then takes the nearest of the four palette colors.
+    void CompressBlockBC1(const uint8_t block[16][3], uint8_t* out)
+    {
+        float mean[3] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                mean[c] += block[i][c];
+        }
+        for (int c = 0; c < 3; ++c)
+            mean[c] /= 16.0f;
+
+        float cov[6] = {};
+        for (int i = 0; i < 16; ++i)
+        {
+            float r = block[i][0] - mean[0];
+            float g = block[i][1] - mean[1];
+            float b = block[i][2] - mean[2];
+            cov[0] += r * r;
+            cov[1] += r * g;
+            cov[2] += r * b;
+            cov[3] += g * g;
+            cov[4] += g * b;
+            cov[5] += b * b;
+        }
+
+        // Power iteration for the principal axis
+        float axis[3] = {1, 1, 1};
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+            float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+            float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+            float length = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float minT = 0, maxT = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        float axisLengthSqr = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axisLengthSqr > 0)
+        {
+            minT /= axisLengthSqr;
+            maxT /= axisLengthSqr;
+        }
+
+        float inset = (maxT - minT) / 16.0f;
+        minT += inset;
+        maxT -= inset;
+
+        uint16_t color0 = PackColor565(mean[0] + axis[0] * maxT, mean[1] + axis[1] * maxT, mean[2] + axis[2] * maxT);
+        uint16_t color1 = PackColor565(mean[0] + axis[0] * minT, mean[1] + axis[1] * minT, mean[2] + axis[2] * minT);
+
+        // Four color mode requires color0 > color1. Equal colors select the three color mode, where index 0 is color0.
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            UnpackColor565(color0, palette[0]);
+            UnpackColor565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                int bestIndex = 0;
+                int bestDistance = INT32_MAX;
+                for (int k = 0; k < 4; ++k)
+                {
+                    int dr = block[i][0] - palette[k][0];
+                    int dg = block[i][1] - palette[k][1];
+                    int db = block[i][2] - palette[k][2];
+                    int distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        bestIndex = k;
+                    }
+                }
+                indices |= uint32_t(bestIndex) << (i * 2);
+            }
+        }
+
+        out[0] = color0 & 0xff;
+        out[1] = color0 >> 8;
+        out[2] = color1 & 0xff;
+        out[3] = color1 >> 8;
+        out[4] = indices & 0xff;
+        out[5] = (indices >> 8) & 0xff;
+        out[6] = (indices >> 16) & 0xff;
+        out[7] = indices >> 24;
+    }
+}
+
+uint32_t BlockCompression::GetMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t size = std::max(width, height);
+    uint32_t count = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        count++;
+    }
+    return count;
+}
+
+size_t BlockCompression::GetBC1Size(uint32_t width, uint32_t height)
+{
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+size_t BlockCompression::GetBC1MipChainSize(uint32_t width, uint32_t height)
+{
+    size_t size = 0;
+    uint32_t mipCount = GetMipCount(width, height);
+    for (uint32_t mip = 0; mip < mipCount; ++mip)
+        size += GetBC1Size(std::max(width >> mip, 1u), std::max(height >> mip, 1u));
+    return size;
+}
+
+void BlockCompression::CompressBC1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+    uint8_t block[16][3];
+
+    for (uint32_t blockY = 0; blockY < height; blockY += 4)
+    {
+        for (uint32_t blockX = 0; blockX < width; blockX += 4)
+        {
+            for (uint32_t y = 0; y < 4; ++y)
+            {
+                const uint8_t* row = rgba + size_t(std::min(blockY + y, height - 1)) * width * 4;
+                for (uint32_t x = 0; x < 4; ++x)
+                {
+                    const uint8_t* pixel = row + size_t(std::min(blockX + x, width - 1)) * 4;
+                    block[y * 4 + x][0] = pixel[0];
+                    block[y * 4 + x][1] = pixel[1];
+                    block[y * 4 + x][2] = pixel[2];
+                }
+            }
+
+            CompressBlockBC1(block, blocks);
+            blocks += 8;
+        }
+    }
+}
+
+void BlockCompression::DownsampleSRGB(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+    const SRGBTable& table = GetSRGBTable();
+
+    uint32_t dstWidth = std::max(width >> 1, 1u);
+    uint32_t dstHeight = std::max(height >> 1, 1u);
+
+    for (uint32_t y = 0; y < dstHeight; ++y)
+    {
+        const uint8_t* row0 = src + size_t(std::min(y * 2, height - 1)) * width * 4;
+        const uint8_t* row1 = src + size_t(std::min(y * 2 + 1, height - 1)) * width * 4;
+
+        for (uint32_t x = 0; x < dstWidth; ++x)
+        {
+            size_t x0 = size_t(std::min(x * 2, width - 1)) * 4;
+            size_t x1 = size_t(std::min(x * 2 + 1, width - 1)) * 4;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                float sum = table.ToLinear[row0[x0 + c]] + table.ToLinear[row0[x1 + c]] +
+                            table.ToLinear[row1[x0 + c]] + table.ToLinear[row1[x1 + c]];
+                *dst++ = LinearToSRGB(sum * 0.25f);
+            }
+            *dst++ = static_cast<uint8_t>((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+        }
+    }
+}
+
+void BlockCompression::CompressBC1MipChain(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+    Vector<uint8_t> mips[2];
+
+    uint32_t mipCount = GetMipCount(width, height);
+    for (uint32_t mip = 0; mip < mipCount; ++mip)
+    {
+        if (mip > 0)
+        {
+            Vector<uint8_t>& mipData = mips[mip & 1];
+            mipData.Resize(size_t(std::max(width >> 1, 1u)) * std::max(height >> 1, 1u) * 4);
+            DownsampleSRGB(rgba, width, height, mipData.ToPtr());
+
+            rgba = mipData.ToPtr();
+            width = std::max(width >> 1, 1u);
+            height = std::max(height >> 1, 1u);
+        }
+
+        CompressBC1(rgba, width, height, blocks);
+        blocks += GetBC1Size(width, height);
+    }
+}
@@ -0,0 +1,56 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU block compression of RGBA8 images for the texture cache.
+namespace BlockCompression
+{
+    // Number of levels of a full mip chain down to 1x1
+    uint32_t        GetMipCount(uint32_t width, uint32_t height);
+
+    // Size of the BC1 blocks of an image (8 bytes per 4x4 block)
+    size_t          GetBC1Size(uint32_t width, uint32_t height);
+
+    // Size of the BC1 blocks of an image and all its mips
+    size_t          GetBC1MipChainSize(uint32_t width, uint32_t height);
+
+    // Compresses an RGBA8 image to BC1. Alpha is ignored. Blocks at the right and bottom edges of images with a size
+    // not divisible by 4 repeat the last column and row.
+    void            CompressBC1(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+
+    // Halves an sRGB RGBA8 image with a box filter in linear space. Sizes are rounded down and stop at 1.
+    void            DownsampleSRGB(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+
+    // Builds the mip chain of an sRGB image and compresses all levels to BC1, the largest level first.
+    // The output must hold GetBC1MipChainSize bytes.
+    void            CompressBC1MipChain(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+}
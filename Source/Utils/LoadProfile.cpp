@@ -0,0 +1,180 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "LoadProfile.h"
+
+#include <cstdio>
+#include <string>
+
+void LoadProfile::Reset(StringView levelName)
+{
+    m_LevelName = levelName;
+    for (auto& phase : m_Phases)
+        phase.store(0, std::memory_order_relaxed);
+    for (auto& counter : m_Counters)
+        counter.store(0, std::memory_order_relaxed);
+    m_TotalTime = 0;
+    m_Batches.Clear();
+}
+
+void LoadProfile::AddBatch(StringView name, uint32_t vertexCount, uint32_t indexCount)
+{
+    Batch& batch = m_Batches.EmplaceBack();
+    batch.Name = name;
+    batch.VertexCount = vertexCount;
+    batch.IndexCount = indexCount;
+}
+
+const char* LoadProfile::sGetPhaseName(PHASE phase)
+{
+    constexpr const char* names[PHASE_MAX] =
+    {
+        "texture_decode",
+        "texture_cache",
+        "dome",
+        "bw_parse",
+        "clip",
+        "triangulate",
+        "texcoords",
+        "batch_merge",
+        "chunking",
+        "mesh_optimize",
+        "mesh_upload",
+        "level_cache",
+        "pvs"
+    };
+    return names[phase];
+}
+
+const char* LoadProfile::sGetCounterName(COUNTER counter)
+{
+    constexpr const char* names[COUNTER_MAX] =
+    {
+        "faces_opaque",
+        "faces_transparent",
+        "faces_single_portal",
+        "faces_multiple_portals",
+        "faces_skydome",
+        "faces_unknown",
+        "bsp_nodes_visited",
+        "triangulate_convex",
+        "triangulate_convex_ring",
+        "triangulate_covered",
+        "triangulate_clipper",
+        "leaf_holes_skipped",
+        "scratch_growths",
+        "scratch_bytes",
+        "triangles",
+        "vertices",
+        "vertices_before_optimize",
+        "vertices_after_optimize",
+        "chunks",
+        "shadow_chunks",
+        "textures",
+        "textures_indexed",
+        "textures_shared",
+        "bytes_shared",
+        "textures_compressed",
+        "bytes_uploaded"
+    };
+    return names[counter];
+}
+
+void LoadProfile::Print() const
+{
+    LOG("Level load profile: {}\n", m_LevelName);
+    LOG("  total: {} ms (wall time)\n", GetTotalMs());
+
+    // Phases on worker threads add up the time of every thread, so they are not comparable to the wall time
+    for (int i = 0; i < PHASE_MAX; ++i)
+        LOG("  {}: {} ms (CPU time)\n", sGetPhaseName(PHASE(i)), GetPhaseMs(PHASE(i)));
+
+    for (int i = 0; i < COUNTER_MAX; ++i)
+        LOG("  {}: {}\n", sGetCounterName(COUNTER(i)), GetCounter(COUNTER(i)));
+
+    for (Batch const& batch : m_Batches)
+        LOG("  batch {}: {} vertices, {} indices\n", batch.Name, batch.VertexCount, batch.IndexCount);
+}
+
+namespace
+{
+    void AppendEscaped(std::string& out, StringView str)
+    {
+        for (size_t i = 0; i < str.Size(); ++i)
+        {
+            char ch = str[i];
+            if (static_cast<unsigned char>(ch) < 0x20)
+                continue;
+            if (ch == '"' || ch == '\\')
+                out += '\\';
+            out += ch;
+        }
+    }
+}
+
+bool LoadProfile::WriteJson(StringView fileName) const
+{
+    File file = File::sOpenWrite(fileName);
+    if (!file)
+        return false;
+
+    char buf[256];
+    std::string json;
+
+    json += "{\n  \"level\": \"";
+    AppendEscaped(json, m_LevelName);
+    json += "\",\n";
+
+    snprintf(buf, sizeof(buf), "  \"total_ms\": %.4f,\n  \"phases_ms\": {\n", GetTotalMs());
+    json += buf;
+    for (int i = 0; i < PHASE_MAX; ++i)
+    {
+        snprintf(buf, sizeof(buf), "    \"%s\": %.4f%s\n", sGetPhaseName(PHASE(i)), GetPhaseMs(PHASE(i)), i + 1 < PHASE_MAX ? "," : "");
+        json += buf;
+    }
+
+    json += "  },\n  \"counters\": {\n";
+    for (int i = 0; i < COUNTER_MAX; ++i)
+    {
+        snprintf(buf, sizeof(buf), "    \"%s\": %llu%s\n", sGetCounterName(COUNTER(i)), (unsigned long long)GetCounter(COUNTER(i)), i + 1 < COUNTER_MAX ? "," : "");
+        json += buf;
+    }
+
+    json += "  },\n  \"batches\": [\n";
+    for (size_t i = 0; i < m_Batches.Size(); ++i)
+    {
+        json += "    {\"name\": \"";
+        AppendEscaped(json, m_Batches[i].Name);
+        snprintf(buf, sizeof(buf), "\", \"vertices\": %u, \"indices\": %u}%s\n", m_Batches[i].VertexCount, m_Batches[i].IndexCount, i + 1 < m_Batches.Size() ? "," : "");
+        json += buf;
+    }
+    json += "  ]\n}\n";
+
+    file.Write(json.data(), json.size());
+    return true;
+}
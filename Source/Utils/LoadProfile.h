@@ -0,0 +1,166 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/IO.h>
+#include <Hork/Core/String.h>
+#include <Hork/Core/Containers/Vector.h>
+
+#include <atomic>
+#include <chrono>
+
+using namespace Hk;
+
+// Timings and counters gathered while a level is loading.
+// Phases may be timed from several threads, so accumulation is atomic and a phase is the CPU time summed over
+// the threads. It may exceed the total, which is wall time.
+class LoadProfile
+{
+public:
+    enum PHASE
+    {
+        PHASE_TEXTURE_DECODE,
+        PHASE_TEXTURE_CACHE,
+        PHASE_DOME,
+        PHASE_BW_PARSE,
+        PHASE_CLIP,
+        PHASE_TRIANGULATE,
+        PHASE_TEXCOORDS,
+        PHASE_BATCH_MERGE,
+        PHASE_CHUNKING,
+        PHASE_MESH_OPTIMIZE,
+        PHASE_MESH_UPLOAD,
+        PHASE_LEVEL_CACHE,
+        PHASE_PVS,
+        PHASE_MAX
+    };
+
+    enum COUNTER
+    {
+        COUNTER_FACES_OPAQUE,
+        COUNTER_FACES_TRANSPARENT,
+        COUNTER_FACES_SINGLE_PORTAL,
+        COUNTER_FACES_MULTIPLE_PORTALS,
+        COUNTER_FACES_SKYDOME,
+        COUNTER_FACES_UNKNOWN,
+        COUNTER_BSP_NODES_VISITED,
+        COUNTER_TRIANGULATE_CONVEX,
+        COUNTER_TRIANGULATE_CONVEX_RING,
+        COUNTER_TRIANGULATE_COVERED,
+        COUNTER_TRIANGULATE_CLIPPER,
+        COUNTER_LEAF_HOLES_SKIPPED,
+        COUNTER_SCRATCH_GROWTHS,
+        COUNTER_SCRATCH_BYTES,
+        COUNTER_TRIANGLES,
+        COUNTER_VERTICES,
+        COUNTER_VERTICES_BEFORE_OPTIMIZE,
+        COUNTER_VERTICES_AFTER_OPTIMIZE,
+        COUNTER_CHUNKS,
+        COUNTER_SHADOW_CHUNKS,
+        COUNTER_TEXTURES,
+        COUNTER_TEXTURES_INDEXED,
+        COUNTER_TEXTURES_SHARED,
+        COUNTER_BYTES_SHARED,
+        COUNTER_TEXTURES_COMPRESSED,
+        COUNTER_BYTES_UPLOADED,
+        COUNTER_MAX
+    };
+
+    struct Batch
+    {
+        String              Name;
+        uint32_t            VertexCount;
+        uint32_t            IndexCount;
+    };
+
+    void                    Reset(StringView levelName);
+
+    void                    AddTime(PHASE phase, uint64_t nanoseconds)
+    {
+        m_Phases[phase].fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    void                    Increment(COUNTER counter, uint64_t amount = 1)
+    {
+        m_Counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    void                    AddBatch(StringView name, uint32_t vertexCount, uint32_t indexCount);
+
+    void                    SetTotalTime(uint64_t nanoseconds) { m_TotalTime = nanoseconds; }
+
+    double                  GetPhaseMs(PHASE phase) const { return m_Phases[phase].load(std::memory_order_relaxed) * 1e-6; }
+    uint64_t                GetCounter(COUNTER counter) const { return m_Counters[counter].load(std::memory_order_relaxed); }
+    double                  GetTotalMs() const { return m_TotalTime * 1e-6; }
+
+    Vector<Batch> const&    GetBatches() const { return m_Batches; }
+
+    // Prints the profile to the log.
+    void                    Print() const;
+
+    // Writes the profile as JSON.
+    bool                    WriteJson(StringView fileName) const;
+
+    static const char*      sGetPhaseName(PHASE phase);
+    static const char*      sGetCounterName(COUNTER counter);
+
+private:
+    String                  m_LevelName;
+    std::atomic<uint64_t>   m_Phases[PHASE_MAX] = {};
+    std::atomic<uint64_t>   m_Counters[COUNTER_MAX] = {};
+    uint64_t                m_TotalTime = 0;
+    Vector<Batch>           m_Batches;
+};
+
+// Adds the lifetime of the scope to a phase of the profile. Null profile disables timing.
+class ScopedPhaseTimer
+{
+public:
+    ScopedPhaseTimer(LoadProfile* profile, LoadProfile::PHASE phase) :
+        m_Profile(profile),
+        m_Phase(phase)
+    {
+        if (m_Profile)
+            m_Start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedPhaseTimer()
+    {
+        if (m_Profile)
+            m_Profile->AddTime(m_Phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count());
+    }
+
+    ScopedPhaseTimer(ScopedPhaseTimer const&) = delete;
+    ScopedPhaseTimer& operator=(ScopedPhaseTimer const&) = delete;
+
+private:
+    LoadProfile*            m_Profile;
+    LoadProfile::PHASE      m_Phase;
+    std::chrono::steady_clock::time_point m_Start;
+};
@@ -0,0 +1,164 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "MappedFile.h"
+
+#include <Hork/Core/Containers/Vector.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(StringView fileName)
+{
+    Close();
+
+    if (Map(fileName))
+    {
+        m_Opened = true;
+        return true;
+    }
+
+    File file = File::sOpenRead(fileName);
+    if (!file)
+        return false;
+
+    m_Blob = file.ReadBlob(file.GetSize());
+    m_Data = reinterpret_cast<const uint8_t*>(m_Blob.GetData());
+    m_Size = m_Blob.Size();
+    m_Opened = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Mapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Mapping);
+        CloseHandle(m_MappingHandle);
+        CloseHandle(m_FileHandle);
+        m_MappingHandle = nullptr;
+        m_FileHandle = nullptr;
+#else
+        munmap(m_Mapping, m_Size);
+#endif
+        m_Mapping = nullptr;
+    }
+
+    m_Blob.Reset();
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Opened = false;
+}
+
+bool MappedFile::Map(StringView fileName)
+{
+    String path(fileName);
+
+#ifdef _WIN32
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.CStr(), -1, nullptr, 0);
+    if (length <= 0)
+        return false;
+
+    Vector<wchar_t> widePath(length);
+    MultiByteToWideChar(CP_UTF8, 0, path.CStr(), -1, widePath.ToPtr(), length);
+
+    HANDLE fileHandle = CreateFileW(widePath.ToPtr(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    void* mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!mapping)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    m_FileHandle = fileHandle;
+    m_MappingHandle = mappingHandle;
+    m_Mapping = mapping;
+    m_Size = size_t(fileSize.QuadPart);
+#else
+    int fd = open(path.CStr(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+#ifdef MADV_SEQUENTIAL
+    madvise(mapping, size_t(st.st_size), MADV_SEQUENTIAL);
+#endif
+
+    m_Mapping = mapping;
+    m_Size = size_t(st.st_size);
+#endif
+
+    m_Data = reinterpret_cast<const uint8_t*>(m_Mapping);
+    return true;
+}
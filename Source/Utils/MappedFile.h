@@ -0,0 +1,68 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/String.h>
+#include <Hork/Core/IO.h>
+
+using namespace Hk;
+
+// Read-only view of a whole file. Uses the OS file mapping when possible and falls back to
+// reading the file into memory (e.g. for files inside archives).
+class MappedFile
+{
+public:
+                            MappedFile() = default;
+                            ~MappedFile();
+
+                            MappedFile(MappedFile const&) = delete;
+    MappedFile&             operator=(MappedFile const&) = delete;
+
+    bool                    Open(StringView fileName);
+    void                    Close();
+
+    bool                    IsOpened() const { return m_Opened; }
+    bool                    IsMapped() const { return m_Mapping != nullptr; }
+
+    const uint8_t*          GetData() const { return m_Data; }
+    size_t                  GetSize() const { return m_Size; }
+
+private:
+    bool                    Map(StringView fileName);
+
+    const uint8_t*          m_Data = nullptr;
+    size_t                  m_Size = 0;
+    void*                   m_Mapping = nullptr;
+#ifdef _WIN32
+    void*                   m_FileHandle = nullptr;
+    void*                   m_MappingHandle = nullptr;
+#endif
+    HeapBlob                m_Blob;
+    bool                    m_Opened = false;
+};
@@ -0,0 +1,153 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/String.h>
+
+#include <cstring>
+#include <type_traits>
+
+using namespace Hk;
+
+// Bounds-checked little-endian reader over a memory span (e.g. a mapped file).
+// Reading past the end yields zeroes and sets a sticky error flag, so parsers can check once at the end.
+class MemoryCursor
+{
+public:
+    MemoryCursor() = default;
+
+    MemoryCursor(const void* data, size_t size) :
+        m_Data(reinterpret_cast<const uint8_t*>(data)),
+        m_Size(size)
+    {}
+
+    bool                    IsValid() const { return !m_Overflow; }
+
+    size_t                  GetOffset() const { return m_Offset; }
+    size_t                  GetSize() const { return m_Size; }
+    size_t                  GetRemaining() const { return m_Size - m_Offset; }
+
+    void                    Seek(size_t offset)
+    {
+        if (offset > m_Size)
+        {
+            m_Overflow = true;
+            offset = m_Size;
+        }
+        m_Offset = offset;
+    }
+
+    // Returns a pointer to the next size bytes and advances the cursor, or nullptr if there are not enough bytes.
+    const uint8_t*          Skip(size_t size)
+    {
+        if (size > GetRemaining())
+        {
+            m_Overflow = true;
+            m_Offset = m_Size;
+            return nullptr;
+        }
+        const uint8_t* ptr = m_Data + m_Offset;
+        m_Offset += size;
+        return ptr;
+    }
+
+    void                    Read(void* dst, size_t size)
+    {
+        if (const uint8_t* src = Skip(size))
+            std::memcpy(dst, src, size);
+        else
+            std::memset(dst, 0, size);
+    }
+
+    template <typename T>
+    T                       ReadObject()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ReadObject requires trivially copyable type");
+        T object;
+        Read(&object, sizeof(T));
+        return object;
+    }
+
+    // Bulk copy of a contiguous array. Fails without reading if the array does not fit.
+    template <typename T>
+    bool                    ReadArray(T* dst, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "ReadArray requires trivially copyable type");
+        if (count > GetRemaining() / sizeof(T))
+        {
+            m_Overflow = true;
+            m_Offset = m_Size;
+            return false;
+        }
+        std::memcpy(dst, m_Data + m_Offset, count * sizeof(T));
+        m_Offset += count * sizeof(T);
+        return true;
+    }
+
+    int16_t                 ReadInt16() { return ReadObject<int16_t>(); }
+    int32_t                 ReadInt32() { return ReadObject<int32_t>(); }
+    uint32_t                ReadUInt32() { return ReadObject<uint32_t>(); }
+    uint64_t                ReadUInt64() { return ReadObject<uint64_t>(); }
+    float                   ReadFloat() { return ReadObject<float>(); }
+    double                  ReadDouble() { return ReadObject<double>(); }
+
+    // Length-prefixed string in the same layout as File::ReadString. The view points into the span.
+    StringView              ReadStringView()
+    {
+        uint32_t length = ReadUInt32();
+        if (const uint8_t* str = Skip(length))
+            return StringView(reinterpret_cast<const char*>(str), length);
+        return {};
+    }
+
+    String                  ReadString()
+    {
+        return String(ReadStringView());
+    }
+
+    // Checks that the next size bytes all equal value and skips them.
+    bool                    ExpectBytes(uint8_t value, size_t size)
+    {
+        const uint8_t* ptr = Skip(size);
+        if (!ptr)
+            return false;
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (ptr[i] != value)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    const uint8_t*          m_Data = nullptr;
+    size_t                  m_Size = 0;
+    size_t                  m_Offset = 0;
+    bool                    m_Overflow = false;
+};
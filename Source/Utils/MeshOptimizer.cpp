@@ -0,0 +1,376 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "MeshOptimizer.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Forsyth's scoring parameters, see "Linear-Speed Vertex Cache Optimisation"
+    constexpr int   ForsythCacheSize = 32;
+    constexpr float CacheDecayPower = 1.5f;
+    constexpr float LastTriangleScore = 0.75f;
+    constexpr float ValenceBoostScale = 2.0f;
+    constexpr float ValenceBoostPower = 0.5f;
+
+    float CalcVertexScore(int cachePosition, uint32_t remainingValence)
+    {
+        // Vertices without remaining triangles don't matter
+        if (remainingValence == 0)
+            return -1.0f;
+
+        float score = 0;
+        if (cachePosition >= 0)
+        {
+            // The vertices of the last triangle get a fixed score, so the algorithm doesn't favor its own previous triangle
+            if (cachePosition < 3)
+                score = LastTriangleScore;
+            else
+                score = std::pow(1.0f - float(cachePosition - 3) / (ForsythCacheSize - 3), CacheDecayPower);
+        }
+
+        // Boost vertices with few triangles left, so they are finished off and don't linger
+        score += ValenceBoostScale * std::pow(float(remainingValence), -ValenceBoostPower);
+        return score;
+    }
+
+    Float3 const& GetPosition(const Float3* positions, size_t positionStride, uint32_t vertex)
+    {
+        return *reinterpret_cast<const Float3*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride);
+    }
+}
+
+uint32_t MeshOptimizer::WeldVertices(void* vertices, size_t vertexSize, uint32_t vertexCount, Vector<uint32_t>& indices)
+{
+    if (vertexCount == 0)
+        return 0;
+
+    uint8_t* data = static_cast<uint8_t*>(vertices);
+
+    // Open addressing table of unique vertex indices, at most half full
+    uint32_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+        tableSize <<= 1;
+
+    constexpr uint32_t EmptySlot = ~0u;
+    Vector<uint32_t> table(tableSize, EmptySlot);
+    Vector<uint32_t> remap(vertexCount);
+
+    uint32_t uniqueCount = 0;
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+        const uint8_t* vertex = data + i * vertexSize;
+
+        uint32_t slot = uint32_t(HashFNV1a(vertex, vertexSize)) & (tableSize - 1);
+        while (table[slot] != EmptySlot && std::memcmp(data + table[slot] * vertexSize, vertex, vertexSize))
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == EmptySlot)
+        {
+            // Unique vertices are compacted in place. They never move backwards past a vertex that is still unread.
+            if (uniqueCount != i)
+                std::memcpy(data + uniqueCount * vertexSize, vertex, vertexSize);
+            table[slot] = uniqueCount++;
+        }
+        remap[i] = table[slot];
+    }
+
+    for (uint32_t& index : indices)
+        index = remap[index];
+
+    return uniqueCount;
+}
+
+void MeshOptimizer::OptimizeVertexCache(Vector<uint32_t>& indices, uint32_t vertexCount)
+{
+    uint32_t triangleCount = indices.Size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Triangles referencing every vertex. The live ones are kept at the front of each list.
+    Vector<uint32_t> remainingValence(vertexCount, 0);
+    for (uint32_t index : indices)
+        remainingValence[index]++;
+
+    Vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] = firstTriangle[v] + remainingValence[v];
+
+    Vector<uint32_t> adjacency(indices.Size());
+    {
+        Vector<uint32_t> fill(vertexCount);
+        std::copy(firstTriangle.begin(), firstTriangle.end() - 1, fill.begin());
+        for (uint32_t i = 0; i < indices.Size(); ++i)
+            adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    Vector<int> cachePosition(vertexCount, -1);
+    Vector<float> vertexScore(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = CalcVertexScore(-1, remainingValence[v]);
+
+    Vector<float> triangleScore(triangleCount);
+    Vector<uint8_t> emitted(triangleCount, 0);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    uint32_t bestTriangle = uint32_t(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+    Vector<uint32_t> cache, newCache;
+    cache.Reserve(ForsythCacheSize + 3);
+    newCache.Reserve(ForsythCacheSize + 3);
+
+    Vector<uint32_t> result;
+    result.Reserve(indices.Size());
+
+    uint32_t scanPosition = 0;
+
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (bestTriangle == ~0u)
+        {
+            // Nothing adjacent to the cache is left, continue with the next triangle in the original order
+            while (emitted[scanPosition])
+                ++scanPosition;
+            bestTriangle = scanPosition;
+        }
+
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+
+        emitted[bestTriangle] = 1;
+        result.Add(triangle[0]);
+        result.Add(triangle[1]);
+        result.Add(triangle[2]);
+
+        // Remove the triangle from the live lists of its vertices
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = triangle[k];
+            uint32_t* list = &adjacency[firstTriangle[v]];
+            uint32_t count = remainingValence[v];
+            for (uint32_t j = 0; j < count; ++j)
+            {
+                if (list[j] == bestTriangle)
+                {
+                    std::swap(list[j], list[count - 1]);
+                    break;
+                }
+            }
+            remainingValence[v]--;
+        }
+
+        // The triangle's vertices move to the front of the LRU cache
+        newCache.Clear();
+        newCache.Add(triangle[0]);
+        newCache.Add(triangle[1]);
+        newCache.Add(triangle[2]);
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.Add(v);
+        }
+
+        // Update the scores of the cached and evicted vertices and their live triangles
+        for (size_t i = 0; i < newCache.Size(); ++i)
+        {
+            uint32_t v = newCache[i];
+            int position = i < ForsythCacheSize ? int(i) : -1;
+
+            cachePosition[v] = position;
+
+            float score = CalcVertexScore(position, remainingValence[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const uint32_t* list = &adjacency[firstTriangle[v]];
+            for (uint32_t j = 0; j < remainingValence[v]; ++j)
+                triangleScore[list[j]] += delta;
+        }
+
+        if (newCache.Size() > ForsythCacheSize)
+            newCache.Resize(ForsythCacheSize);
+        std::swap(cache, newCache);
+
+        // The next triangle is the best one that uses a cached vertex
+        bestTriangle = ~0u;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+        {
+            const uint32_t* list = &adjacency[firstTriangle[v]];
+            for (uint32_t j = 0; j < remainingValence[v]; ++j)
+            {
+                if (triangleScore[list[j]] > bestScore)
+                {
+                    bestScore = triangleScore[list[j]];
+                    bestTriangle = list[j];
+                }
+            }
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(Vector<uint32_t>& indices, const Float3* positions, size_t positionStride, uint32_t vertexCount, float threshold)
+{
+    uint32_t triangleCount = indices.Size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Split the triangles into clusters where the cache is effectively flushed,
+    // so that reordering whole clusters keeps most of the vertex cache efficiency
+    Vector<uint32_t> clusters;
+    {
+        Vector<uint32_t> cacheTime(vertexCount, 0);
+        uint32_t time = DefaultCacheSize + 1;
+
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                uint32_t v = indices[t * 3 + k];
+                if (time - cacheTime[v] > DefaultCacheSize)
+                {
+                    cacheTime[v] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusters.Add(t);
+        }
+    }
+
+    if (clusters.Size() < 2)
+        return;
+
+    Float3 meshCenter(0.0f);
+    for (uint32_t index : indices)
+        meshCenter += GetPosition(positions, positionStride, index);
+    meshCenter /= float(indices.Size());
+
+    // Sort clusters so that the ones facing away from the center, which are likely to occlude the rest, go first
+    struct ClusterKey
+    {
+        uint32_t Cluster;
+        float    Key;
+    };
+    Vector<ClusterKey> keys(clusters.Size());
+
+    for (uint32_t c = 0; c < clusters.Size(); ++c)
+    {
+        uint32_t first = clusters[c];
+        uint32_t last = c + 1 < clusters.Size() ? clusters[c + 1] : triangleCount;
+
+        Float3 center(0.0f);
+        Float3 normal(0.0f);
+        float area = 0;
+        for (uint32_t t = first; t < last; ++t)
+        {
+            Float3 const& p0 = GetPosition(positions, positionStride, indices[t * 3]);
+            Float3 const& p1 = GetPosition(positions, positionStride, indices[t * 3 + 1]);
+            Float3 const& p2 = GetPosition(positions, positionStride, indices[t * 3 + 2]);
+
+            Float3 n = Math::Cross(p1 - p0, p2 - p0);
+            float a = n.Length();
+
+            center += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+
+        keys[c].Cluster = c;
+        keys[c].Key = area > 0 ? Math::Dot(center / area - meshCenter, normal / area) : 0.0f;
+    }
+
+    std::stable_sort(keys.begin(), keys.end(), [](ClusterKey const& a, ClusterKey const& b) { return a.Key > b.Key; });
+
+    Vector<uint32_t> result;
+    result.Reserve(indices.Size());
+    for (ClusterKey const& key : keys)
+    {
+        uint32_t first = clusters[key.Cluster];
+        uint32_t last = key.Cluster + 1 < clusters.Size() ? clusters[key.Cluster + 1] : triangleCount;
+        for (uint32_t i = first * 3; i < last * 3; ++i)
+            result.Add(indices[i]);
+    }
+
+    if (CalcACMR(result, vertexCount) <= CalcACMR(indices, vertexCount) * threshold)
+        indices = std::move(result);
+}
+
+uint32_t MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexSize, uint32_t vertexCount, Vector<uint32_t>& indices)
+{
+    constexpr uint32_t Unused = ~0u;
+    Vector<uint32_t> remap(vertexCount, Unused);
+
+    uint32_t newCount = 0;
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == Unused)
+            remap[index] = newCount++;
+        index = remap[index];
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(vertices);
+    Vector<uint8_t> reordered(size_t(newCount) * vertexSize);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] != Unused)
+            std::memcpy(&reordered[remap[v] * vertexSize], src + v * vertexSize, vertexSize);
+    }
+
+    std::memcpy(vertices, reordered.ToPtr(), reordered.Size());
+    return newCount;
+}
+
+float MeshOptimizer::CalcACMR(Vector<uint32_t> const& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    uint32_t triangleCount = indices.Size() / 3;
+    if (triangleCount == 0)
+        return 0;
+
+    // FIFO cache: a vertex is cached if it was transformed less than cacheSize misses ago
+    Vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint32_t misses = 0;
+
+    for (uint32_t index : indices)
+    {
+        if (time - cacheTime[index] > cacheSize)
+        {
+            cacheTime[index] = time++;
+            misses++;
+        }
+    }
+    return float(misses) / triangleCount;
+}
@@ -0,0 +1,96 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/Containers/Vector.h>
+#include <Hork/Math/VectorMath.h>
+
+using namespace Hk;
+
+// Index buffer optimizations for static geometry.
+// Vertices are passed as raw memory with a stride, so the functions work with any vertex format.
+namespace MeshOptimizer
+{
+    // Post-transform cache size used to measure ACMR
+    constexpr uint32_t DefaultCacheSize = 16;
+
+    // Merges bitwise identical vertices and remaps the indices. Returns the new vertex count.
+    uint32_t        WeldVertices(void* vertices, size_t vertexSize, uint32_t vertexCount, Vector<uint32_t>& indices);
+
+    // Reorders triangles to improve post-transform cache hits (Forsyth's linear-speed algorithm).
+    void            OptimizeVertexCache(Vector<uint32_t>& indices, uint32_t vertexCount);
+
+    // Reorders clusters of triangles so that front-facing clusters tend to be drawn first.
+    // The result is accepted only if the ACMR doesn't grow by more than the threshold (e.g. 1.05 for 5%).
+    void            OptimizeOverdraw(Vector<uint32_t>& indices, const Float3* positions, size_t positionStride, uint32_t vertexCount, float threshold);
+
+    // Reorders vertices in the order they are first referenced. Unreferenced vertices are dropped.
+    // Returns the new vertex count.
+    uint32_t        OptimizeVertexFetch(void* vertices, size_t vertexSize, uint32_t vertexCount, Vector<uint32_t>& indices);
+
+    // Average cache miss ratio: transformed vertices per triangle with a FIFO cache of the given size.
+    float           CalcACMR(Vector<uint32_t> const& indices, uint32_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+
+    struct Stats
+    {
+        uint32_t    VerticesBefore = 0;
+        uint32_t    VerticesAfter = 0;
+        float       ACMRBefore = 0;
+        float       ACMRAfter = 0;
+    };
+
+    // Runs welding, vertex cache, overdraw and vertex fetch optimization. The vertex type must have a Float3 Position.
+    template <typename VertexType>
+    Stats           Optimize(Vector<VertexType>& vertices, Vector<uint32_t>& indices)
+    {
+        Stats stats;
+        stats.VerticesBefore = vertices.Size();
+        stats.ACMRBefore = CalcACMR(indices, vertices.Size());
+
+        if (vertices.IsEmpty() || indices.IsEmpty())
+        {
+            stats.VerticesAfter = stats.VerticesBefore;
+            stats.ACMRAfter = stats.ACMRBefore;
+            return stats;
+        }
+
+        uint32_t vertexCount = WeldVertices(vertices.ToPtr(), sizeof(VertexType), vertices.Size(), indices);
+        vertices.Resize(vertexCount);
+
+        OptimizeVertexCache(indices, vertexCount);
+        OptimizeOverdraw(indices, &vertices[0].Position, sizeof(VertexType), vertexCount, 1.05f);
+
+        vertexCount = OptimizeVertexFetch(vertices.ToPtr(), sizeof(VertexType), vertexCount, indices);
+        vertices.Resize(vertexCount);
+
+        stats.VerticesAfter = vertices.Size();
+        stats.ACMRAfter = CalcACMR(indices, vertices.Size());
+        return stats;
+    }
+}
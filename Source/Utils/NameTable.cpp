@@ -0,0 +1,122 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "NameTable.h"
+
+#include <Hork/Core/Containers/Hash.h>
+#include <Hork/Core/Containers/Vector.h>
+#include <Hork/Core/UniqueRef.h>
+
+#include <mutex>
+#include <shared_mutex>
+
+namespace
+{
+    struct NameTableData
+    {
+        // Readers (Find, GetName and Intern of a known name) share the lock, only new names take it exclusively
+        std::shared_mutex                           Mutex;
+        // Lowercased name -> atom
+        StringHashMap<NameAtom>                     Atoms;
+        // Original spelling indexed by atom - 1. Each name is allocated separately, so views of it stay valid.
+        Vector<UniqueRef<String>>                   Names;
+    };
+
+    NameTableData& GetData()
+    {
+        static NameTableData data;
+        return data;
+    }
+
+    void ToLower(StringView name, String& key)
+    {
+        key = name;
+        char* str = key.ToPtr();
+        for (size_t i = 0; i < name.Size(); ++i)
+            str[i] = Core::CharToLower(str[i]);
+    }
+}
+
+NameAtom NameTable::Intern(StringView name)
+{
+    NameTableData& data = GetData();
+
+    thread_local String key;
+    ToLower(name, key);
+
+    {
+        std::shared_lock lock(data.Mutex);
+        auto it = data.Atoms.Find(key);
+        if (it != data.Atoms.End())
+            return it->second;
+    }
+
+    std::unique_lock lock(data.Mutex);
+
+    // Another thread may have added the name between the locks
+    auto it = data.Atoms.Find(key);
+    if (it != data.Atoms.End())
+        return it->second;
+
+    data.Names.Add(MakeUnique<String>(name));
+
+    NameAtom atom = static_cast<NameAtom>(data.Names.Size());
+    data.Atoms[key] = atom;
+    return atom;
+}
+
+NameAtom NameTable::Find(StringView name)
+{
+    NameTableData& data = GetData();
+
+    thread_local String key;
+    ToLower(name, key);
+
+    std::shared_lock lock(data.Mutex);
+    auto it = data.Atoms.Find(key);
+    return it != data.Atoms.End() ? it->second : InvalidNameAtom;
+}
+
+StringView NameTable::GetName(NameAtom atom)
+{
+    NameTableData& data = GetData();
+
+    std::shared_lock lock(data.Mutex);
+    if (atom == InvalidNameAtom || atom > data.Names.Size())
+        return {};
+
+    return *data.Names[atom - 1].RawPtr();
+}
+
+size_t NameTable::GetCount()
+{
+    NameTableData& data = GetData();
+
+    std::shared_lock lock(data.Mutex);
+    return data.Names.Size();
+}
@@ -0,0 +1,57 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/String.h>
+
+using namespace Hk;
+
+// Identifier of an interned name. Equal names (ignoring ASCII case) always get the same atom.
+using NameAtom = uint32_t;
+
+constexpr NameAtom InvalidNameAtom = 0;
+
+// Process-wide case-insensitive string interning table. Atoms are stable for the lifetime of the process,
+// so loaders can resolve texture, material and atmosphere names once and compare integers afterwards.
+// All functions are thread safe.
+class NameTable
+{
+public:
+    // Returns the atom of the name, adding it to the table if it's new
+    static NameAtom         Intern(StringView name);
+
+    // Returns the atom of the name or InvalidNameAtom if it was never interned
+    static NameAtom         Find(StringView name);
+
+    // Returns the name as it was spelled when first interned. The view stays valid until the process exits.
+    static StringView       GetName(NameAtom atom);
+
+    // Number of interned names
+    static size_t           GetCount();
+};
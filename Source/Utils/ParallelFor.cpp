@@ -0,0 +1,170 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "ParallelFor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<size_t> ThreadCountOverride{0};
+
+    // Set on pool threads and on a thread while it runs a ParallelFor
+    thread_local bool InsideParallelFor = false;
+
+    class ThreadPool
+    {
+    public:
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard lock(m_Mutex);
+                m_Stop = true;
+            }
+            m_WakeUp.notify_all();
+
+            for (auto& thread : m_Threads)
+                thread.join();
+        }
+
+        bool Run(size_t count, size_t threadCount, ParallelForFunc func, void* context)
+        {
+            if (InsideParallelFor)
+                return false;
+
+            std::unique_lock runLock(m_RunMutex, std::try_to_lock);
+            if (!runLock)
+                return false;
+
+            {
+                std::lock_guard lock(m_Mutex);
+
+                while (m_Threads.size() < threadCount - 1)
+                    m_Threads.emplace_back(&ThreadPool::WorkerMain, this, m_Threads.size());
+
+                m_Func = func;
+                m_Context = context;
+                m_Count = count;
+                m_NextIndex.store(0, std::memory_order_relaxed);
+                m_WorkerCount = threadCount - 1;
+                m_Busy = m_WorkerCount;
+                m_Generation++;
+            }
+            m_WakeUp.notify_all();
+
+            InsideParallelFor = true;
+            RunItems();
+            InsideParallelFor = false;
+
+            std::unique_lock lock(m_Mutex);
+            m_Done.wait(lock, [this]() { return m_Busy == 0; });
+            return true;
+        }
+
+    private:
+        void WorkerMain(size_t workerIndex)
+        {
+            InsideParallelFor = true;
+
+            uint64_t generation = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock lock(m_Mutex);
+                    m_WakeUp.wait(lock, [&]() { return m_Stop || m_Generation != generation; });
+                    if (m_Stop)
+                        return;
+
+                    generation = m_Generation;
+
+                    // The call may use fewer threads than the pool has
+                    if (workerIndex >= m_WorkerCount)
+                        continue;
+                }
+
+                RunItems();
+
+                std::lock_guard lock(m_Mutex);
+                if (--m_Busy == 0)
+                    m_Done.notify_one();
+            }
+        }
+
+        void RunItems()
+        {
+            for (size_t index = m_NextIndex.fetch_add(1, std::memory_order_relaxed); index < m_Count; index = m_NextIndex.fetch_add(1, std::memory_order_relaxed))
+                m_Func(m_Context, index);
+        }
+
+        std::mutex                  m_RunMutex;     // Held by the thread that runs a ParallelFor on the pool
+        std::mutex                  m_Mutex;
+        std::condition_variable     m_WakeUp;
+        std::condition_variable     m_Done;
+        std::vector<std::thread>    m_Threads;
+        bool                        m_Stop = false;
+
+        // Current call
+        uint64_t                    m_Generation = 0;
+        size_t                      m_WorkerCount = 0;
+        size_t                      m_Busy = 0;
+        ParallelForFunc             m_Func = nullptr;
+        void*                       m_Context = nullptr;
+        size_t                      m_Count = 0;
+        std::atomic<size_t>         m_NextIndex{0};
+    };
+
+    ThreadPool& GetThreadPool()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+}
+
+size_t GetParallelThreadCount()
+{
+    size_t threadCount = ThreadCountOverride.load(std::memory_order_relaxed);
+    if (threadCount)
+        return threadCount;
+
+    threadCount = std::thread::hardware_concurrency();
+    return threadCount ? threadCount : 1;
+}
+
+void SetParallelThreadCount(size_t threadCount)
+{
+    ThreadCountOverride.store(threadCount, std::memory_order_relaxed);
+}
+
+bool RunParallelFor(size_t count, size_t threadCount, ParallelForFunc func, void* context)
+{
+    return GetThreadPool().Run(count, threadCount, func, context);
+}
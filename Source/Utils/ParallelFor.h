@@ -0,0 +1,73 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+// Number of threads used by ParallelFor (including the calling thread). Defaults to the hardware thread count.
+size_t GetParallelThreadCount();
+
+// Overrides the thread count. Zero restores the default, one makes ParallelFor run serially.
+void SetParallelThreadCount(size_t threadCount);
+
+using ParallelForFunc = void (*)(void* context, size_t index);
+
+// Runs func(context, index) for every index in [0, count) on the calling thread and threadCount - 1 pool threads.
+// Returns false without running anything if the pool is taken: by an outer ParallelFor of the calling thread or by
+// a ParallelFor of another thread.
+bool RunParallelFor(size_t count, size_t threadCount, ParallelForFunc func, void* context);
+
+// Calls func(index) for every index in [0, count) from a pool of threads and waits for completion.
+// Indices are handed out one at a time, so it balances well for items of uneven cost.
+// Pool threads live for the whole process, so their thread_local state survives between calls.
+// Nested calls, and calls made while another thread is using the pool, run serially on the calling thread.
+template <typename Func>
+void ParallelFor(size_t count, Func&& func)
+{
+    using FuncType = std::remove_reference_t<Func>;
+
+    size_t threadCount = GetParallelThreadCount();
+    if (threadCount > count)
+        threadCount = count;
+
+    if (threadCount > 1)
+    {
+        auto call = [](void* context, size_t index)
+        {
+            (*static_cast<FuncType*>(context))(index);
+        };
+
+        if (RunParallelFor(count, threadCount, call, const_cast<void*>(static_cast<const void*>(&func))))
+            return;
+    }
+
+    for (size_t index = 0; index < count; ++index)
+        func(index);
+}
@@ -0,0 +1,336 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "PortalCulling.h"
+#include "SectorPVS.h"
+
+using namespace Hk;
+
+namespace
+{
+    // Tolerance for points lying on sector and portal planes, in meters
+    constexpr float PlaneEpsilon = 0.01f;
+
+    // If the eye is closer to the portal plane than this, the portal can't narrow the view
+    constexpr float PortalNearDistance = 0.05f;
+
+    void ClipPolygon(Vector<Float3> const& in, PlaneF const& plane, Vector<Float3>& out)
+    {
+        out.Clear();
+
+        uint32_t count = in.Size();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Float3 const& a = in[i];
+            Float3 const& b = in[(i + 1) % count];
+
+            float da = plane.DistanceToPoint(a);
+            float db = plane.DistanceToPoint(b);
+
+            if (da >= 0)
+                out.Add(a);
+
+            if ((da >= 0) != (db >= 0))
+                out.Add(a + (b - a) * (da / (da - db)));
+        }
+    }
+}
+
+void PortalCulling::Initialize(CompiledLevel const& level)
+{
+    m_Sectors = level.Sectors;
+    m_SectorPlanes = level.SectorPlanes;
+    m_Portals = level.Portals;
+    m_PortalVertices = level.PortalVertices;
+    m_PvsData = level.PvsData;
+    m_PvsRow.Resize(SectorPVS::GetRowSize(m_Sectors.Size()));
+    m_PvsSector = -1;
+
+    m_Visible.Resize(m_Sectors.Size());
+    m_OnPath.Resize(m_Sectors.Size());
+    for (uint32_t i = 0; i < m_Sectors.Size(); ++i)
+    {
+        m_Visible[i] = 1;
+        m_OnPath[i] = 0;
+    }
+    m_VisibleCount = m_Sectors.Size();
+    m_ViewSector = -1;
+}
+
+void PortalCulling::Clear()
+{
+    m_Sectors.Clear();
+    m_SectorPlanes.Clear();
+    m_Portals.Clear();
+    m_PortalVertices.Clear();
+    m_PvsData.Clear();
+    m_PvsRow.Clear();
+    m_PvsSector = -1;
+    m_Visible.Clear();
+    m_OnPath.Clear();
+    m_VisibleCount = 0;
+    m_ViewSector = -1;
+}
+
+bool PortalCulling::IsInsideSector(int32_t sector, Float3 const& position) const
+{
+    CompiledLevel::Sector const& s = m_Sectors[sector];
+
+    if (position.X < s.Bounds.Mins.X - PlaneEpsilon || position.X > s.Bounds.Maxs.X + PlaneEpsilon ||
+        position.Y < s.Bounds.Mins.Y - PlaneEpsilon || position.Y > s.Bounds.Maxs.Y + PlaneEpsilon ||
+        position.Z < s.Bounds.Mins.Z - PlaneEpsilon || position.Z > s.Bounds.Maxs.Z + PlaneEpsilon)
+        return false;
+
+    for (uint32_t i = 0; i < s.PlaneCount; ++i)
+    {
+        if (m_SectorPlanes[s.FirstPlane + i].DistanceToPoint(position) < -PlaneEpsilon)
+            return false;
+    }
+    return true;
+}
+
+int32_t PortalCulling::FindSector(Float3 const& position) const
+{
+    for (int32_t sector = 0; sector < int32_t(m_Sectors.Size()); ++sector)
+    {
+        if (IsInsideSector(sector, position))
+            return sector;
+    }
+    return -1;
+}
+
+bool PortalCulling::Update(Float3 const& viewPosition, const PlaneF* frustumPlanes, int frustumPlaneCount)
+{
+    int32_t viewSector = -1;
+
+    // The camera usually stays in the same sector or moves to a neighbor
+    if (m_ViewSector >= 0)
+    {
+        if (IsInsideSector(m_ViewSector, viewPosition))
+            viewSector = m_ViewSector;
+        else
+        {
+            CompiledLevel::Sector const& s = m_Sectors[m_ViewSector];
+            for (uint32_t i = 0; i < s.PortalCount && viewSector < 0; ++i)
+            {
+                int32_t toSector = m_Portals[s.FirstPortal + i].ToSector;
+                if (IsInsideSector(toSector, viewPosition))
+                    viewSector = toSector;
+            }
+        }
+    }
+    if (viewSector < 0)
+        viewSector = FindSector(viewPosition);
+
+    m_ViewSector = viewSector;
+
+    if (viewSector < 0)
+    {
+        for (uint8_t& visible : m_Visible)
+            visible = 1;
+        m_VisibleCount = m_Sectors.Size();
+        return false;
+    }
+
+    if (m_UsePVS && HasPVS())
+    {
+        UpdatePVS(frustumPlanes, frustumPlaneCount);
+        return true;
+    }
+
+    for (uint8_t& visible : m_Visible)
+        visible = 0;
+    m_VisibleCount = 0;
+    m_PortalVisits = 0;
+    m_ViewPosition = viewPosition;
+
+    m_PlaneStack.Clear();
+    for (int i = 0; i < frustumPlaneCount; ++i)
+        m_PlaneStack.Add(frustumPlanes[i]);
+
+    m_OnPath[viewSector] = 1;
+    Flood_r(viewSector, 0, frustumPlaneCount, 0);
+    m_OnPath[viewSector] = 0;
+    return true;
+}
+
+void PortalCulling::UpdatePVS(const PlaneF* frustumPlanes, int frustumPlaneCount)
+{
+    if (m_PvsSector != m_ViewSector)
+    {
+        CompiledLevel::Sector const& s = m_Sectors[m_ViewSector];
+        if (!SectorPVS::DecompressBits(m_PvsData.ToPtr() + s.FirstPvsByte, s.PvsByteCount, m_PvsRow.ToPtr(), m_PvsRow.Size()))
+        {
+            for (uint8_t& bits : m_PvsRow)
+                bits = 0xff;
+        }
+        m_PvsSector = m_ViewSector;
+    }
+
+    // PVS AND sectors whose bounds intersect the frustum
+    m_VisibleCount = 0;
+    for (int32_t sector = 0; sector < int32_t(m_Sectors.Size()); ++sector)
+    {
+        uint8_t visible = (m_PvsRow[sector >> 3] >> (sector & 7)) & 1;
+
+        BvAxisAlignedBox const& bounds = m_Sectors[sector].Bounds;
+        for (int i = 0; i < frustumPlaneCount && visible; ++i)
+        {
+            PlaneF const& plane = frustumPlanes[i];
+
+            // Corner of the box farthest along the plane normal
+            Float3 corner(plane.Normal.X > 0 ? bounds.Maxs.X : bounds.Mins.X,
+                          plane.Normal.Y > 0 ? bounds.Maxs.Y : bounds.Mins.Y,
+                          plane.Normal.Z > 0 ? bounds.Maxs.Z : bounds.Mins.Z);
+            if (plane.DistanceToPoint(corner) < -PlaneEpsilon)
+                visible = 0;
+        }
+
+        if (sector == m_ViewSector)
+            visible = 1;
+
+        m_Visible[sector] = visible;
+        m_VisibleCount += visible;
+    }
+}
+
+void PortalCulling::Flood_r(int32_t sector, uint32_t firstPlane, uint32_t planeCount, int depth)
+{
+    if (!m_Visible[sector])
+    {
+        m_Visible[sector] = 1;
+        ++m_VisibleCount;
+    }
+
+    if (depth >= MaxDepth)
+        return;
+
+    CompiledLevel::Sector const& s = m_Sectors[sector];
+    for (uint32_t portalNum = 0; portalNum < s.PortalCount; ++portalNum)
+    {
+        if (++m_PortalVisits > MaxPortalVisits)
+            return;
+
+        CompiledLevel::Portal const& portal = m_Portals[s.FirstPortal + portalNum];
+        if (m_OnPath[portal.ToSector])
+            continue;
+
+        if (!ClipPortal(portal, firstPlane, planeCount))
+            continue;
+
+        Vector<Float3> const& polygon = m_ClipBuffer[0];
+
+        Float3 center(0.0f);
+        Float3 normal(0.0f);
+        for (uint32_t i = 0; i < polygon.Size(); ++i)
+        {
+            Float3 const& a = polygon[i];
+            Float3 const& b = polygon[(i + 1) % polygon.Size()];
+
+            center += a;
+            normal += Math::Cross(a, b);
+        }
+        center /= float(polygon.Size());
+
+        uint32_t newFirstPlane = firstPlane;
+        uint32_t newPlaneCount = planeCount;
+
+        float normalLength = normal.Length();
+        if (normalLength > 0 && Math::Abs(Math::Dot(normal, m_ViewPosition - center)) / normalLength > PortalNearDistance)
+        {
+            // Planes through the eye and the edges of the visible part of the portal
+            newFirstPlane = m_PlaneStack.Size();
+            for (uint32_t i = 0; i < polygon.Size(); ++i)
+            {
+                Float3 const& a = polygon[i];
+                Float3 const& b = polygon[(i + 1) % polygon.Size()];
+
+                Float3 edgeNormal = Math::Cross(a - m_ViewPosition, b - m_ViewPosition);
+                float length = edgeNormal.Length();
+                if (length < 1e-6f)
+                    continue;
+                edgeNormal /= length;
+
+                PlaneF& plane = m_PlaneStack.EmplaceBack();
+                plane.Normal = edgeNormal;
+                plane.D = -Math::Dot(edgeNormal, m_ViewPosition);
+                if (plane.DistanceToPoint(center) < 0)
+                {
+                    plane.Normal = -plane.Normal;
+                    plane.D = -plane.D;
+                }
+            }
+            newPlaneCount = m_PlaneStack.Size() - newFirstPlane;
+        }
+
+        m_OnPath[portal.ToSector] = 1;
+        Flood_r(portal.ToSector, newFirstPlane, newPlaneCount, depth + 1);
+        m_OnPath[portal.ToSector] = 0;
+
+        if (newFirstPlane != firstPlane)
+            m_PlaneStack.Resize(newFirstPlane);
+    }
+}
+
+bool PortalCulling::ClipPortal(CompiledLevel::Portal const& portal, uint32_t firstPlane, uint32_t planeCount)
+{
+    Vector<Float3>& polygon = m_ClipBuffer[0];
+
+    polygon.Clear();
+    for (uint32_t i = 0; i < portal.VertexCount; ++i)
+        polygon.Add(m_PortalVertices[portal.FirstVertex + i]);
+
+    for (uint32_t i = 0; i < planeCount && polygon.Size() >= 3; ++i)
+    {
+        // Keep the portal if it touches the frustum
+        PlaneF plane = m_PlaneStack[firstPlane + i];
+        plane.D += PlaneEpsilon;
+
+        ClipPolygon(polygon, plane, m_ClipBuffer[1]);
+        std::swap(m_ClipBuffer[0], m_ClipBuffer[1]);
+    }
+
+    return m_ClipBuffer[0].Size() >= 3;
+}
+
+void PortalCulling::sGetFrustumPlanes(Float3 const& position, Float3 const& forward, Float3 const& right, Float3 const& up, float fovX, float fovY, PlaneF planes[4])
+{
+    float halfX = Math::Radians(fovX * 0.5f);
+    float halfY = Math::Radians(fovY * 0.5f);
+
+    float sx = Math::Sin(halfX), cx = Math::Cos(halfX);
+    float sy = Math::Sin(halfY), cy = Math::Cos(halfY);
+
+    planes[0].Normal = forward * sx + right * cx;   // Left
+    planes[1].Normal = forward * sx - right * cx;   // Right
+    planes[2].Normal = forward * sy + up * cy;      // Bottom
+    planes[3].Normal = forward * sy - up * cy;      // Top
+
+    for (int i = 0; i < 4; ++i)
+        planes[i].D = -Math::Dot(planes[i].Normal, position);
+}
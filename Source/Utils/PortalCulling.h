@@ -0,0 +1,111 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Hork/Core/Containers/Vector.h>
+#include <Hork/Math/Plane.h>
+
+#include "../DataFormats/CompiledLevel.h"
+
+using namespace Hk;
+
+// Sector visibility from the portal graph of a compiled level.
+// Starting from the sector of the camera, the view frustum is narrowed through every portal
+// it passes and the sectors reached this way are marked visible.
+// With the precomputed PVS, the potentially visible sectors of the camera sector are only tested against the frustum.
+class PortalCulling
+{
+public:
+    // Sectors deeper than this along one portal chain are not visited
+    static constexpr int    MaxDepth = 32;
+
+    // Limits the work per frame on levels with many redundant portal paths
+    static constexpr int    MaxPortalVisits = 4096;
+
+    // Copies the sector graph of the level
+    void                    Initialize(CompiledLevel const& level);
+
+    void                    Clear();
+
+    // Returns the convex sector that contains the point or -1 if the point is outside of the level
+    int32_t                 FindSector(Float3 const& position) const;
+
+    // Use the precomputed PVS instead of portal flooding if the level has one
+    void                    SetUsePVS(bool usePVS) { m_UsePVS = usePVS; }
+
+    bool                    HasPVS() const { return !m_PvsData.IsEmpty(); }
+
+    // Updates the visible sectors. The frustum planes face inside.
+    // Returns false if the camera is not inside any sector; all sectors are marked visible then.
+    bool                    Update(Float3 const& viewPosition, const PlaneF* frustumPlanes, int frustumPlaneCount);
+
+    bool                    IsSectorVisible(int32_t sector) const { return sector >= 0 && sector < int32_t(m_Visible.Size()) && m_Visible[sector]; }
+
+    int32_t                 GetViewSector() const { return m_ViewSector; }
+
+    int32_t                 GetSectorCount() const { return m_Sectors.Size(); }
+
+    int32_t                 GetVisibleSectorCount() const { return m_VisibleCount; }
+
+    // Side planes of a symmetric perspective frustum. Angles are full field of view in degrees.
+    static void             sGetFrustumPlanes(Float3 const& position, Float3 const& forward, Float3 const& right, Float3 const& up, float fovX, float fovY, PlaneF planes[4]);
+
+private:
+    bool                    IsInsideSector(int32_t sector, Float3 const& position) const;
+
+    void                    UpdatePVS(const PlaneF* frustumPlanes, int frustumPlaneCount);
+
+    void                    Flood_r(int32_t sector, uint32_t firstPlane, uint32_t planeCount, int depth);
+
+    // Clips the portal polygon by the planes. The result is left in m_ClipBuffer[0].
+    bool                    ClipPortal(CompiledLevel::Portal const& portal, uint32_t firstPlane, uint32_t planeCount);
+
+    Vector<CompiledLevel::Sector> m_Sectors;
+    Vector<PlaneF>          m_SectorPlanes;
+    Vector<CompiledLevel::Portal> m_Portals;
+    Vector<Float3>          m_PortalVertices;
+    Vector<uint8_t>         m_PvsData;
+
+    bool                    m_UsePVS = true;
+
+    // Decompressed PVS of the sector m_PvsSector
+    Vector<uint8_t>         m_PvsRow;
+    int32_t                 m_PvsSector = -1;
+
+    Vector<uint8_t>         m_Visible;
+    Vector<uint8_t>         m_OnPath;
+    int32_t                 m_VisibleCount = 0;
+    int32_t                 m_ViewSector = -1;
+    int                     m_PortalVisits = 0;
+    Float3                  m_ViewPosition;
+
+    // Frustum planes of the current portal chain. Each recursion level appends its planes.
+    Vector<PlaneF>          m_PlaneStack;
+    Vector<Float3>          m_ClipBuffer[2];
+};
@@ -0,0 +1,391 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "SectorPVS.h"
+#include "ParallelFor.h"
+
+#include <atomic>
+
+using namespace Hk;
+
+namespace
+{
+    constexpr float Epsilon = 0.001f;
+
+    using Winding = Vector<Float3>;
+
+    // Keeps the part of the winding in front of the plane
+    void ClipWinding(Winding const& in, PlaneF const& plane, Winding& out)
+    {
+        out.Clear();
+
+        uint32_t count = in.Size();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            Float3 const& a = in[i];
+            Float3 const& b = in[(i + 1) % count];
+
+            float da = plane.DistanceToPoint(a);
+            float db = plane.DistanceToPoint(b);
+
+            if (da >= -Epsilon)
+                out.Add(a);
+
+            if ((da > Epsilon && db < -Epsilon) || (da < -Epsilon && db > Epsilon))
+                out.Add(a + (b - a) * (da / (da - db)));
+        }
+    }
+
+    // Clips the target by the planes that have the source behind and the pass in front.
+    // Planes are built from an edge of one winding and a vertex of the other.
+    bool ClipToSeparators(Winding const& source, Winding const& pass, Winding& target, Winding& scratch)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            Winding const& edges = side == 0 ? source : pass;
+            Winding const& points = side == 0 ? pass : source;
+
+            for (uint32_t i = 0; i < edges.Size(); ++i)
+            {
+                Float3 const& e0 = edges[i];
+                Float3 const& e1 = edges[(i + 1) % edges.Size()];
+
+                for (Float3 const& point : points)
+                {
+                    Float3 normal = Math::Cross(e1 - e0, point - e0);
+                    float length = normal.Length();
+                    if (length < 1e-6f)
+                        continue;
+
+                    PlaneF plane;
+                    plane.Normal = normal / length;
+                    plane.D = -Math::Dot(plane.Normal, e0);
+
+                    bool sourceFront = false, sourceBack = false;
+                    for (Float3 const& p : source)
+                    {
+                        float d = plane.DistanceToPoint(p);
+                        sourceFront = sourceFront || d > Epsilon;
+                        sourceBack = sourceBack || d < -Epsilon;
+                    }
+                    if (sourceFront && sourceBack)
+                        continue;
+                    if (sourceFront)
+                    {
+                        plane.Normal = -plane.Normal;
+                        plane.D = -plane.D;
+                    }
+
+                    bool passFront = false, passBack = false;
+                    for (Float3 const& p : pass)
+                    {
+                        float d = plane.DistanceToPoint(p);
+                        passFront = passFront || d > Epsilon;
+                        passBack = passBack || d < -Epsilon;
+                    }
+                    if (passBack || !passFront)
+                        continue;
+
+                    ClipWinding(target, plane, scratch);
+                    std::swap(target, scratch);
+                    if (target.Size() < 3)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    struct FlowContext
+    {
+        CompiledLevel const& Level;
+
+        // Portal planes face the sector the portal leads to
+        Vector<PlaneF> const& PortalPlanes;
+
+        Vector<uint8_t> Visible;
+        Vector<uint8_t> OnPath;
+        int Steps = 0;
+        bool Overflow = false;
+    };
+
+    Winding GetPortalWinding(CompiledLevel const& level, uint32_t portalIndex)
+    {
+        CompiledLevel::Portal const& portal = level.Portals[portalIndex];
+
+        Winding winding(portal.VertexCount);
+        for (uint32_t i = 0; i < portal.VertexCount; ++i)
+            winding[i] = level.PortalVertices[portal.FirstVertex + i];
+        return winding;
+    }
+
+    // The pass is the visible part of the portal that leads to the sector
+    void Flow_r(FlowContext& context, Winding const& source, PlaneF const& sourcePlane, Winding const& pass, PlaneF const& passPlane, int32_t sector, int depth)
+    {
+        context.Visible[sector] = 1;
+
+        if (depth >= SectorPVS::MaxDepth)
+        {
+            context.Overflow = true;
+            return;
+        }
+
+        CompiledLevel::Sector const& s = context.Level.Sectors[sector];
+
+        Winding target, scratch;
+        for (uint32_t portalNum = 0; portalNum < s.PortalCount; ++portalNum)
+        {
+            if (++context.Steps > SectorPVS::MaxPortalSteps)
+            {
+                context.Overflow = true;
+                return;
+            }
+
+            uint32_t portalIndex = s.FirstPortal + portalNum;
+            int32_t toSector = context.Level.Portals[portalIndex].ToSector;
+            if (context.OnPath[toSector])
+                continue;
+
+            // The target must lie in front of both the source and the pass
+            ClipWinding(GetPortalWinding(context.Level, portalIndex), sourcePlane, target);
+            if (target.Size() < 3)
+                continue;
+            ClipWinding(target, passPlane, scratch);
+            std::swap(target, scratch);
+            if (target.Size() < 3)
+                continue;
+
+            if (!ClipToSeparators(source, pass, target, scratch))
+                continue;
+
+            context.OnPath[toSector] = 1;
+            Flow_r(context, source, sourcePlane, target, context.PortalPlanes[portalIndex], toSector, depth + 1);
+            context.OnPath[toSector] = 0;
+
+            if (context.Overflow)
+                return;
+        }
+    }
+
+    // Sectors reachable through any chain of portals
+    void FloodConnected(CompiledLevel const& level, int32_t sector, Vector<uint8_t>& visible)
+    {
+        Vector<int32_t> stack;
+        stack.Add(sector);
+        visible[sector] = 1;
+        while (!stack.IsEmpty())
+        {
+            CompiledLevel::Sector const& s = level.Sectors[stack.Last()];
+            stack.RemoveLast();
+
+            for (uint32_t i = 0; i < s.PortalCount; ++i)
+            {
+                int32_t toSector = level.Portals[s.FirstPortal + i].ToSector;
+                if (!visible[toSector])
+                {
+                    visible[toSector] = 1;
+                    stack.Add(toSector);
+                }
+            }
+        }
+    }
+
+    // Plane of the portal, facing away from the sector that owns it
+    PlaneF GetPortalPlane(CompiledLevel const& level, int32_t sector, uint32_t portalIndex)
+    {
+        CompiledLevel::Portal const& portal = level.Portals[portalIndex];
+        const Float3* points = level.PortalVertices.ToPtr() + portal.FirstVertex;
+
+        Float3 center(0.0f);
+        Float3 normal(0.0f);
+        for (uint32_t i = 0; i < portal.VertexCount; ++i)
+        {
+            center += points[i];
+            normal += Math::Cross(points[i], points[(i + 1) % portal.VertexCount]);
+        }
+        center /= float(portal.VertexCount);
+
+        PlaneF plane;
+        plane.Normal = normal.Normalized();
+        plane.D = -Math::Dot(plane.Normal, center);
+
+        // Sector planes face inside. The portal lies on one of them.
+        CompiledLevel::Sector const& s = level.Sectors[sector];
+        for (uint32_t i = 0; i < s.PlaneCount; ++i)
+        {
+            PlaneF const& sectorPlane = level.SectorPlanes[s.FirstPlane + i];
+            if (Math::Abs(Math::Dot(sectorPlane.Normal, plane.Normal)) > 0.999f && Math::Abs(sectorPlane.DistanceToPoint(center)) < 0.01f)
+            {
+                plane.Normal = -sectorPlane.Normal;
+                plane.D = -sectorPlane.D;
+                return plane;
+            }
+        }
+
+        Float3 sectorCenter = (s.Bounds.Mins + s.Bounds.Maxs) * 0.5f;
+        if (plane.DistanceToPoint(sectorCenter) > 0)
+        {
+            plane.Normal = -plane.Normal;
+            plane.D = -plane.D;
+        }
+        return plane;
+    }
+}
+
+void SectorPVS::Compute(CompiledLevel& level)
+{
+    uint32_t sectorCount = level.Sectors.Size();
+    uint32_t rowSize = GetRowSize(sectorCount);
+
+    Vector<PlaneF> portalPlanes(level.Portals.Size());
+    for (uint32_t sector = 0; sector < sectorCount; ++sector)
+    {
+        CompiledLevel::Sector const& s = level.Sectors[sector];
+        for (uint32_t i = 0; i < s.PortalCount; ++i)
+            portalPlanes[s.FirstPortal + i] = GetPortalPlane(level, sector, s.FirstPortal + i);
+    }
+
+    Vector<Vector<uint8_t>> rows(sectorCount);
+    Vector<uint32_t> visibleCounts(sectorCount);
+    std::atomic<uint32_t> overflowCount{0};
+
+    ParallelFor(sectorCount, [&](size_t sector)
+        {
+            FlowContext context{level, portalPlanes};
+            context.Visible.Resize(sectorCount);
+            context.OnPath.Resize(sectorCount);
+            for (uint32_t i = 0; i < sectorCount; ++i)
+            {
+                context.Visible[i] = 0;
+                context.OnPath[i] = 0;
+            }
+
+            context.Visible[sector] = 1;
+            context.OnPath[sector] = 1;
+
+            CompiledLevel::Sector const& s = level.Sectors[sector];
+            for (uint32_t portalNum = 0; portalNum < s.PortalCount && !context.Overflow; ++portalNum)
+            {
+                uint32_t portalIndex = s.FirstPortal + portalNum;
+                int32_t toSector = level.Portals[portalIndex].ToSector;
+                if (context.OnPath[toSector])
+                    continue;
+
+                Winding source = GetPortalWinding(level, portalIndex);
+
+                context.OnPath[toSector] = 1;
+                Flow_r(context, source, portalPlanes[portalIndex], source, portalPlanes[portalIndex], toSector, 1);
+                context.OnPath[toSector] = 0;
+            }
+
+            if (context.Overflow)
+            {
+                FloodConnected(level, sector, context.Visible);
+                overflowCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            Vector<uint8_t> bits(rowSize);
+            for (uint32_t i = 0; i < rowSize; ++i)
+                bits[i] = 0;
+            for (uint32_t i = 0; i < sectorCount; ++i)
+            {
+                if (context.Visible[i])
+                    bits[i >> 3] |= 1 << (i & 7);
+            }
+            visibleCounts[sector] = 0;
+            for (uint32_t i = 0; i < sectorCount; ++i)
+                visibleCounts[sector] += context.Visible[i];
+
+            CompressBits(bits.ToPtr(), rowSize, rows[sector]);
+        });
+
+    level.PvsData.Clear();
+
+    uint64_t visiblePairs = 0;
+    for (uint32_t sector = 0; sector < sectorCount; ++sector)
+    {
+        CompiledLevel::Sector& s = level.Sectors[sector];
+        s.FirstPvsByte = level.PvsData.Size();
+        s.PvsByteCount = rows[sector].Size();
+        level.PvsData.Add(rows[sector]);
+
+        visiblePairs += visibleCounts[sector];
+    }
+
+    if (sectorCount)
+        LOG("Sector PVS: {} sectors, {} visible on average, {} bytes, {} sectors overflowed\n",
+            sectorCount, double(visiblePairs) / sectorCount, level.PvsData.Size(), overflowCount.load());
+}
+
+void SectorPVS::CompressBits(const uint8_t* bits, uint32_t byteCount, Vector<uint8_t>& compressed)
+{
+    compressed.Clear();
+
+    for (uint32_t i = 0; i < byteCount;)
+    {
+        if (bits[i])
+        {
+            compressed.Add(bits[i++]);
+            continue;
+        }
+
+        uint32_t run = 0;
+        while (i < byteCount && !bits[i] && run < 255)
+        {
+            ++run;
+            ++i;
+        }
+        compressed.Add(0);
+        compressed.Add(run);
+    }
+}
+
+bool SectorPVS::DecompressBits(const uint8_t* compressed, uint32_t compressedSize, uint8_t* bits, uint32_t byteCount)
+{
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < compressedSize; ++i)
+    {
+        if (compressed[i])
+        {
+            if (out >= byteCount)
+                return false;
+            bits[out++] = compressed[i];
+            continue;
+        }
+
+        if (++i >= compressedSize)
+            return false;
+
+        uint32_t run = compressed[i];
+        if (out + run > byteCount)
+            return false;
+        for (uint32_t k = 0; k < run; ++k)
+            bits[out++] = 0;
+    }
+    return out == byteCount;
+}
@@ -0,0 +1,56 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "../DataFormats/CompiledLevel.h"
+
+using namespace Hk;
+
+// Offline sector-to-sector visibility (potentially visible set) from the portal windings of a compiled level.
+// A sector is potentially visible from another if some line passes through a chain of portals between them.
+// The test is conservative: it may report hidden sectors as visible, never the opposite.
+namespace SectorPVS
+{
+    // Portal chains longer than this are not followed. Sectors behind them are assumed visible.
+    constexpr int       MaxDepth = 64;
+
+    // Portal steps per source sector. When exceeded, all sectors connected to the source are assumed visible.
+    constexpr int       MaxPortalSteps = 1 << 16;
+
+    // Computes the visibility of every sector in parallel and stores compressed bitsets in level.PvsData
+    void                Compute(CompiledLevel& level);
+
+    // Zero bytes are stored as a zero followed by the run length, other bytes as is
+    void                CompressBits(const uint8_t* bits, uint32_t byteCount, Vector<uint8_t>& compressed);
+
+    // Returns false if the data is damaged
+    bool                DecompressBits(const uint8_t* compressed, uint32_t compressedSize, uint8_t* bits, uint32_t byteCount);
+
+    inline uint32_t     GetRowSize(uint32_t sectorCount) { return (sectorCount + 7) >> 3; }
+}
@@ -0,0 +1,869 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+// Synthetic Blade asset generator.
+//
+// Usage: openblade_assetgen <output directory> [options]
+//
+// Writes a level (.lvl, .bw, texture pack and dome .mmp), a skinned model (.BOD) and an animation (.BMV)
+// with the same layout the DataFormats loaders parse, so loader and level build scaling can be measured
+// without the retail game data. See PrintUsage for the options.
+
+#include "DataFormats/BW.h"
+
+#include <Hork/Core/IO.h>
+#include <Hork/Math/VectorMath.h>
+#include <Hork/Math/Plane.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+using namespace Hk;
+
+namespace
+{
+    struct GeneratorSettings
+    {
+        std::string Name = "gen";
+        int         SectorCount = 150;      // Roughly casa.lvl
+        int         FacesPerSector = 12;
+        int         PortalsPerWall = 1;     // > 1 writes FT_MULTIPLE_PORTALS faces
+        int         BSPDepth = 3;
+        int         TextureCount = 32;
+        int         TextureSize = 256;
+        int         Scale = 1;
+        int         BoneCount = 20;
+        int         ModelFaces = 2000;
+        int         FrameCount = 60;
+        uint32_t    Seed = 1;
+    };
+
+    constexpr double RoomWidth = 4000;
+    constexpr double RoomHeight = 3000;
+    constexpr double DoorWidth = 1000;
+    constexpr double DoorHeight = 2000;
+    constexpr double TwoPi = 6.28318530717958647692;
+
+    uint32_t Random(uint32_t& state)
+    {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void WritePadding(File& file, int count, uint8_t value)
+    {
+        for (int i = 0; i < count; ++i)
+            file.Write(&value, 1);
+    }
+
+    void WriteColor(File& file, uint8_t r, uint8_t g, uint8_t b)
+    {
+        uint8_t color[3] = {r, g, b};
+        file.Write(color, 3);
+    }
+
+    PlaneD MakePlane(Double3 const& normal, Double3 const& point)
+    {
+        PlaneD plane;
+        plane.Normal = normal;
+        plane.D = -Math::Dot(normal, point);
+        return plane;
+    }
+
+    String TextureName(int textureNum)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "gen_tex_%d", textureNum);
+        return name;
+    }
+
+    class WorldWriter
+    {
+    public:
+        explicit WorldWriter(GeneratorSettings const& settings) :
+            m_Settings(settings)
+        {}
+
+        bool Write(StringView fileName);
+
+        int FaceCount = 0;
+        int PortalCount = 0;
+        int NodeCount = 0;
+
+    private:
+        struct Wall
+        {
+            Double3     Origin;     // Bottom left corner seen from inside the room
+            Double3     U;          // Unit vector along the wall
+            Double3     Normal;     // Points into the room
+            int32_t     ToSector;   // -1 for solid walls
+        };
+
+        struct FaceRecord
+        {
+            BladeWorld::FACE_TYPE       Type;
+            PlaneD                      Plane;
+            Double3                     TexCoordAxis[2];
+            int                         TextureNum;
+            Vector<uint32_t>            Winding;
+            Vector<Vector<uint32_t>>    Holes;
+            Wall                        Source;     // Walls only
+        };
+
+        uint32_t AddVertex(Double3 const& v);
+        void     AddWinding(Vector<uint32_t>& indices, Double3 const& normal, Double3 const* points, int count);
+
+        void     BuildSector(int sectorIndex);
+        void     BuildWall(Wall const& wall, int sectorIndex);
+
+        void     WriteSector(File& file, int sectorIndex);
+        void     WriteFace(File& file, FaceRecord const& face);
+        void     WriteTexInfo(File& file, Double3 const& u, Double3 const& v, int textureNum);
+        void     WriteTangentPlanes(File& file, FaceRecord const& face, Vector<uint32_t> const& hole);
+        void     WriteBSPNode_r(File& file, Wall const& wall, double u0, double u1, double y0, double y1, int depth, int holeCount);
+        void     WriteIndices(File& file, Vector<uint32_t> const& indices);
+
+        Double3  RoomOrigin(int sectorIndex) const;
+        int      Neighbor(int sectorIndex, int dx, int dz) const;
+
+        GeneratorSettings const&    m_Settings;
+        int                         m_SectorCount = 0;
+        int                         m_GridWidth = 1;
+        Vector<Double3>             m_Vertices;
+        Vector<Vector<FaceRecord>>  m_SectorFaces;
+    };
+
+    uint32_t WorldWriter::AddVertex(Double3 const& v)
+    {
+        m_Vertices.Add(v);
+        return m_Vertices.Size() - 1;
+    }
+
+    // Blade stores windings clockwise when seen from the front side of the face plane
+    void WorldWriter::AddWinding(Vector<uint32_t>& indices, Double3 const& normal, Double3 const* points, int count)
+    {
+        bool ccw = Math::Dot(Math::Cross(points[1] - points[0], points[2] - points[0]), normal) > 0;
+
+        indices.Clear();
+        for (int i = 0; i < count; ++i)
+            indices.Add(AddVertex(points[ccw ? count - i - 1 : i]));
+    }
+
+    Double3 WorldWriter::RoomOrigin(int sectorIndex) const
+    {
+        int x = sectorIndex % m_GridWidth;
+        int z = sectorIndex / m_GridWidth;
+        return Double3(x * RoomWidth, 0, z * RoomWidth);
+    }
+
+    int WorldWriter::Neighbor(int sectorIndex, int dx, int dz) const
+    {
+        int x = sectorIndex % m_GridWidth + dx;
+        int z = sectorIndex / m_GridWidth + dz;
+        if (x < 0 || x >= m_GridWidth || z < 0)
+            return -1;
+        int neighbor = z * m_GridWidth + x;
+        return neighbor < m_SectorCount ? neighbor : -1;
+    }
+
+    void WorldWriter::BuildSector(int sectorIndex)
+    {
+        Double3 origin = RoomOrigin(sectorIndex);
+
+        // Blade's Y axis points down, so the ceiling is at -RoomHeight
+        const Wall walls[4] =
+        {
+            {origin,                                    Double3(0, 0, 1),  Double3(1, 0, 0),  Neighbor(sectorIndex, -1, 0)},
+            {origin + Double3(RoomWidth, 0, RoomWidth), Double3(0, 0, -1), Double3(-1, 0, 0), Neighbor(sectorIndex, 1, 0)},
+            {origin + Double3(RoomWidth, 0, 0),         Double3(-1, 0, 0), Double3(0, 0, 1),  Neighbor(sectorIndex, 0, -1)},
+            {origin + Double3(0, 0, RoomWidth),         Double3(1, 0, 0),  Double3(0, 0, -1), Neighbor(sectorIndex, 0, 1)},
+        };
+
+        for (Wall const& wall : walls)
+            BuildWall(wall, sectorIndex);
+
+        // Floor and ceiling are split into strips to reach the requested face count
+        int stripCount = Math::Clamp((m_Settings.FacesPerSector - 4) / 2, 1, 48);
+        double stripWidth = RoomWidth / stripCount;
+        for (int strip = 0; strip < stripCount; ++strip)
+        {
+            for (int ceiling = 0; ceiling < 2; ++ceiling)
+            {
+                double y = ceiling ? -RoomHeight : 0.0;
+                Double3 normal = ceiling ? Double3(0, 1, 0) : Double3(0, -1, 0);
+                Double3 points[4] =
+                {
+                    origin + Double3(strip * stripWidth,       y, 0),
+                    origin + Double3((strip + 1) * stripWidth, y, 0),
+                    origin + Double3((strip + 1) * stripWidth, y, RoomWidth),
+                    origin + Double3(strip * stripWidth,       y, RoomWidth)
+                };
+
+                FaceRecord& face = m_SectorFaces[sectorIndex].EmplaceBack();
+                face.Type = BladeWorld::FT_OPAQUE;
+                face.Plane = MakePlane(normal, points[0]);
+                face.TexCoordAxis[0] = Double3(1, 0, 0);
+                face.TexCoordAxis[1] = Double3(0, 0, 1);
+                face.TextureNum = (sectorIndex + strip + ceiling) % m_Settings.TextureCount;
+                AddWinding(face.Winding, normal, points, 4);
+            }
+        }
+    }
+
+    void WorldWriter::BuildWall(Wall const& wall, int sectorIndex)
+    {
+        const Double3 up(0, -1, 0);
+
+        int holeCount = wall.ToSector == -1 ? 0 : m_Settings.PortalsPerWall;
+
+        FaceRecord& face = m_SectorFaces[sectorIndex].EmplaceBack();
+
+        face.Type = holeCount == 0 ? BladeWorld::FT_OPAQUE : (holeCount == 1 ? BladeWorld::FT_SINGLE_PORTAL : BladeWorld::FT_MULTIPLE_PORTALS);
+        face.Plane = MakePlane(wall.Normal, wall.Origin);
+        face.TexCoordAxis[0] = wall.U;
+        face.TexCoordAxis[1] = up;
+        face.TextureNum = (sectorIndex + m_SectorFaces[sectorIndex].Size()) % m_Settings.TextureCount;
+        face.Source = wall;
+
+        Double3 points[4] =
+        {
+            wall.Origin,
+            wall.Origin + wall.U * RoomWidth,
+            wall.Origin + wall.U * RoomWidth + up * RoomHeight,
+            wall.Origin + up * RoomHeight
+        };
+        AddWinding(face.Winding, wall.Normal, points, 4);
+
+        if (holeCount == 0)
+            return;
+
+        // Doors are spread evenly along the wall
+        double spacing = RoomWidth / holeCount;
+        double doorWidth = Math::Min(DoorWidth, spacing * 0.5);
+        double doorHeight = holeCount > 1 ? DoorHeight * 0.5 : DoorHeight;
+
+        face.Holes.Resize(holeCount);
+        for (int hole = 0; hole < holeCount; ++hole)
+        {
+            double u0 = spacing * (hole + 0.5) - doorWidth * 0.5;
+            double u1 = u0 + doorWidth;
+            double y0 = 100;
+
+            Double3 holePoints[4] =
+            {
+                wall.Origin + wall.U * u0 + up * y0,
+                wall.Origin + wall.U * u1 + up * y0,
+                wall.Origin + wall.U * u1 + up * (y0 + doorHeight),
+                wall.Origin + wall.U * u0 + up * (y0 + doorHeight)
+            };
+            AddWinding(face.Holes[hole], wall.Normal, holePoints, 4);
+        }
+    }
+
+    void WorldWriter::WriteIndices(File& file, Vector<uint32_t> const& indices)
+    {
+        file.WriteInt32(indices.Size());
+        for (uint32_t index : indices)
+            file.WriteUInt32(index);
+    }
+
+    void WorldWriter::WriteTexInfo(File& file, Double3 const& u, Double3 const& v, int textureNum)
+    {
+        file.WriteUInt64(3);
+        file.WriteString(TextureName(textureNum));
+        file.WriteObject(u);
+        file.WriteObject(v);
+        file.WriteFloat(0);
+        file.WriteFloat(0);
+        WritePadding(file, 8, 0);
+    }
+
+    bool WorldWriter::Write(StringView fileName)
+    {
+        m_SectorCount = m_Settings.SectorCount * m_Settings.Scale;
+        m_GridWidth = Math::Max(1, int(std::sqrt(double(m_SectorCount))));
+
+        // Build geometry first: vertices precede sectors in the file
+        m_Vertices.Clear();
+        m_SectorFaces.Clear();
+        m_SectorFaces.Resize(m_SectorCount);
+        for (int sectorIndex = 0; sectorIndex < m_SectorCount; ++sectorIndex)
+            BuildSector(sectorIndex);
+
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        // Atmospheres
+        file.WriteInt32(1);
+        file.WriteString("gen_atmo");
+        WriteColor(file, 128, 128, 128);
+        file.WriteFloat(0.0f);
+
+        file.WriteInt32(m_Vertices.Size());
+        for (Double3 const& v : m_Vertices)
+            file.WriteObject(v);
+
+        file.WriteInt32(m_SectorCount);
+
+        FaceCount = 0;
+        PortalCount = 0;
+        NodeCount = 0;
+        for (int sectorIndex = 0; sectorIndex < m_SectorCount; ++sectorIndex)
+            WriteSector(file, sectorIndex);
+
+        // Lights: one point light per sector and a sun over everything
+        file.WriteInt32(m_SectorCount + 1);
+        for (int sectorIndex = 0; sectorIndex < m_SectorCount; ++sectorIndex)
+        {
+            file.WriteInt32(BladeWorld::LT_POINT);
+            WriteColor(file, 255, 220, 180);
+            file.WriteFloat(5.0f);
+            file.WriteFloat(0.0f);
+            file.WriteObject(RoomOrigin(sectorIndex) + Double3(RoomWidth * 0.5, -RoomHeight * 0.8, RoomWidth * 0.5));
+            file.WriteInt32(sectorIndex);
+        }
+        file.WriteInt32(BladeWorld::LT_DIRECTIONAL);
+        WriteColor(file, 255, 255, 255);
+        file.WriteFloat(1.0f);
+        file.WriteFloat(0.0f);
+        WritePadding(file, 36, 0);
+        file.WriteObject(Double3(1, 1, 1).Normalized());
+        file.WriteInt32(m_SectorCount);
+        for (int sectorIndex = 0; sectorIndex < m_SectorCount; ++sectorIndex)
+            file.WriteInt32(sectorIndex);
+
+        // Unknown
+        file.WriteObject(Double3(0));
+        file.WriteObject(Double3(0));
+
+        // Sector groups
+        for (int sectorIndex = 0; sectorIndex < m_SectorCount; ++sectorIndex)
+            file.WriteInt32(0);
+
+        // Strings
+        file.WriteInt32(0);
+
+        return true;
+    }
+
+    void WorldWriter::WriteSector(File& file, int sectorIndex)
+    {
+        file.WriteString("gen_atmo");
+
+        WriteColor(file, 64, 64, 64);
+        file.WriteFloat(0.2f);
+        file.WriteFloat(0.0f);
+        WritePadding(file, 24, 0);
+        WritePadding(file, 8, 0xCD);
+        WritePadding(file, 4, 0);
+
+        WriteColor(file, 255, 255, 255);
+        file.WriteFloat(0.5f);
+        file.WriteFloat(0.0f);
+        WritePadding(file, 24, 0);
+        WritePadding(file, 8, 0xCD);
+        WritePadding(file, 4, 0);
+
+        file.WriteObject(Double3(0, 1, 0));
+
+        Vector<FaceRecord> const& faces = m_SectorFaces[sectorIndex];
+
+        file.WriteInt32(faces.Size());
+        for (FaceRecord const& face : faces)
+            WriteFace(file, face);
+    }
+
+    void WorldWriter::WriteTangentPlanes(File& file, FaceRecord const& face, Vector<uint32_t> const& hole)
+    {
+        // Planes through the hole edges, perpendicular to the face
+        file.WriteInt32(hole.Size());
+        for (int i = 0; i < hole.Size(); ++i)
+        {
+            Double3 const& a = m_Vertices[hole[i]];
+            Double3 const& b = m_Vertices[hole[(i + 1) % hole.Size()]];
+            file.WriteObject(MakePlane(Math::Cross(b - a, face.Plane.Normal).Normalized(), a));
+        }
+        ++PortalCount;
+    }
+
+    void WorldWriter::WriteFace(File& file, FaceRecord const& face)
+    {
+        ++FaceCount;
+
+        file.WriteInt32(face.Type);
+        file.WriteObject(face.Plane);
+        WriteTexInfo(file, face.TexCoordAxis[0], face.TexCoordAxis[1], face.TextureNum);
+        WriteIndices(file, face.Winding);
+
+        switch (face.Type)
+        {
+            case BladeWorld::FT_SINGLE_PORTAL:
+                WriteIndices(file, face.Holes[0]);
+                file.WriteInt32(face.Source.ToSector);
+                WriteTangentPlanes(file, face, face.Holes[0]);
+                break;
+
+            case BladeWorld::FT_MULTIPLE_PORTALS:
+                file.WriteInt32(face.Holes.Size());
+                for (auto const& hole : face.Holes)
+                {
+                    WriteIndices(file, hole);
+                    file.WriteInt32(face.Source.ToSector);
+                    WriteTangentPlanes(file, face, hole);
+                }
+                WriteBSPNode_r(file, face.Source, 0, RoomWidth, 0, RoomHeight, 0, face.Holes.Size());
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void WorldWriter::WriteBSPNode_r(File& file, Wall const& wall, double u0, double u1, double y0, double y1, int depth, int holeCount)
+    {
+        ++NodeCount;
+
+        if (depth >= m_Settings.BSPDepth)
+        {
+            file.WriteInt32(BladeWorld::NT_LEAF);
+            file.WriteInt32(1);
+            file.WriteInt32(0);
+            file.WriteInt32(holeCount);
+            for (int hole = 0; hole < holeCount; ++hole)
+                file.WriteInt32(hole);
+            return;
+        }
+
+        const Double3 up(0, -1, 0);
+
+        // Alternate vertical and horizontal splits
+        bool splitU = (depth & 1) == 0;
+        double mid = splitU ? (u0 + u1) * 0.5 : (y0 + y1) * 0.5;
+
+        Double3 normal = splitU ? wall.U : up;
+        Double3 point = wall.Origin + (splitU ? wall.U * mid : up * mid);
+
+        bool texInfo = (depth & 1) == 1;
+
+        file.WriteInt32(texInfo ? BladeWorld::NT_TEXINFO : BladeWorld::NT_NODE);
+
+        // Front child first
+        if (splitU)
+        {
+            WriteBSPNode_r(file, wall, mid, u1, y0, y1, depth + 1, holeCount);
+            WriteBSPNode_r(file, wall, u0, mid, y0, y1, depth + 1, holeCount);
+        }
+        else
+        {
+            WriteBSPNode_r(file, wall, u0, u1, mid, y1, depth + 1, holeCount);
+            WriteBSPNode_r(file, wall, u0, u1, y0, mid, depth + 1, holeCount);
+        }
+
+        file.WriteObject(MakePlane(normal, point));
+
+        if (texInfo)
+            WriteTexInfo(file, wall.U, up, depth % m_Settings.TextureCount);
+    }
+
+    uint32_t Checksum(const uint8_t* data, size_t size)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ data[i]) * 16777619u;
+        return hash;
+    }
+
+    void WriteTexture(File& file, StringView name, int32_t type, int32_t width, int32_t height, uint32_t& seed)
+    {
+        size_t pixelCount = size_t(width) * height;
+
+        HeapBlob data;
+        switch (type)
+        {
+            case 1: // Palette
+            {
+                data.Reset(pixelCount + 768);
+                uint8_t* pixels = reinterpret_cast<uint8_t*>(data.GetData());
+                for (size_t i = 0; i < pixelCount; ++i)
+                    pixels[i] = uint8_t(Random(seed));
+                // 6 bits per component
+                for (size_t i = 0; i < 768; ++i)
+                    pixels[pixelCount + i] = uint8_t(Random(seed) & 63);
+                break;
+            }
+            case 2: // Grayscale
+            {
+                data.Reset(pixelCount);
+                uint8_t* pixels = reinterpret_cast<uint8_t*>(data.GetData());
+                for (size_t i = 0; i < pixelCount; ++i)
+                    pixels[i] = uint8_t(Random(seed));
+                break;
+            }
+            default: // Truecolor
+            {
+                data.Reset(pixelCount * 3);
+                uint8_t* pixels = reinterpret_cast<uint8_t*>(data.GetData());
+                for (size_t i = 0; i < pixelCount * 3; ++i)
+                    pixels[i] = uint8_t(Random(seed));
+                break;
+            }
+        }
+
+        file.WriteInt16(2);
+        file.WriteUInt32(Checksum(reinterpret_cast<const uint8_t*>(data.GetData()), data.Size()));
+        file.WriteInt32(int32_t(data.Size()) + 12);
+        file.WriteString(name);
+        file.WriteInt32(type);
+        file.WriteInt32(width);
+        file.WriteInt32(height);
+        file.Write(data.GetData(), data.Size());
+    }
+
+    bool WriteTexturePack(StringView fileName, GeneratorSettings const& settings)
+    {
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        uint32_t seed = settings.Seed;
+
+        const int32_t types[] = {1, 2, 4};
+
+        file.WriteInt32(settings.TextureCount);
+        for (int i = 0; i < settings.TextureCount; ++i)
+            WriteTexture(file, TextureName(i), types[i % 3], settings.TextureSize, settings.TextureSize, seed);
+        return true;
+    }
+
+    bool WriteDome(StringView fileName, GeneratorSettings const& settings)
+    {
+        const char* domeNames[6] =
+        {
+            "DomeRight",
+            "DomeLeft",
+            "DomeUp",
+            "DomeDown",
+            "DomeBack",
+            "DomeFront"
+        };
+
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        uint32_t seed = settings.Seed + 1;
+
+        file.WriteInt32(6);
+        for (int i = 0; i < 6; ++i)
+            WriteTexture(file, domeNames[i], 1, settings.TextureSize, settings.TextureSize, seed);
+        return true;
+    }
+
+    void WriteMatrix(File& file, Double3 const& translation)
+    {
+        // Row-major with translation in the last row, as stored by Blade
+        const double m[16] =
+        {
+            1, 0, 0, 0,
+            0, 1, 0, 0,
+            0, 0, 1, 0,
+            translation.X, translation.Y, translation.Z, 1
+        };
+        for (double v : m)
+            file.WriteDouble(v);
+    }
+
+    bool WriteModel(StringView fileName, GeneratorSettings const& settings)
+    {
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        uint32_t seed = settings.Seed + 2;
+
+        int boneCount = Math::Max(1, settings.BoneCount);
+
+        // A column of rings, one band of rings per bone
+        const int ringVertexCount = 16;
+        int ringCount = Math::Max(2, settings.ModelFaces / (ringVertexCount * 2) + 1);
+        ringCount = Math::Max(ringCount, boneCount);
+
+        int vertexCount = ringCount * ringVertexCount;
+        const double segmentHeight = 50;
+
+        file.WriteString(PathUtils::sGetFilenameNoExt(fileName));
+
+        file.WriteInt32(vertexCount);
+        for (int ring = 0; ring < ringCount; ++ring)
+        {
+            for (int i = 0; i < ringVertexCount; ++i)
+            {
+                double angle = TwoPi * i / ringVertexCount;
+                Double3 normal(std::cos(angle), 0, std::sin(angle));
+                file.WriteObject(normal * 200.0 + Double3(0, -ring * segmentHeight, 0));
+                file.WriteObject(normal);
+            }
+        }
+
+        int faceCount = (ringCount - 1) * ringVertexCount * 2;
+        file.WriteInt32(faceCount);
+        for (int ring = 0; ring < ringCount - 1; ++ring)
+        {
+            for (int i = 0; i < ringVertexCount; ++i)
+            {
+                int a = ring * ringVertexCount + i;
+                int b = ring * ringVertexCount + (i + 1) % ringVertexCount;
+                int c = a + ringVertexCount;
+                int d = b + ringVertexCount;
+
+                const int tris[2][3] = {{a, b, c}, {b, d, c}};
+                for (auto const& tri : tris)
+                {
+                    file.WriteInt32(tri[0]);
+                    file.WriteInt32(tri[1]);
+                    file.WriteInt32(tri[2]);
+                    file.WriteString(TextureName((ring / 4) % settings.TextureCount));
+                    for (int k = 0; k < 6; ++k)
+                        file.WriteFloat((Random(seed) & 0xffff) / 65535.0f);
+                    file.WriteInt32(0);
+                }
+            }
+        }
+
+        // Bones own consecutive runs of rings
+        file.WriteInt32(boneCount);
+        int firstVertex = 0;
+        for (int bone = 0; bone < boneCount; ++bone)
+        {
+            int ringsPerBone = ringCount / boneCount + (bone < ringCount % boneCount ? 1 : 0);
+            int boneVertexCount = ringsPerBone * ringVertexCount;
+
+            if (boneCount != 1)
+            {
+                char boneName[32];
+                snprintf(boneName, sizeof(boneName), "gen_bone_%d", bone);
+                file.WriteString(boneName);
+            }
+            file.WriteInt32(bone - 1);
+            WriteMatrix(file, bone == 0 ? Double3(0) : Double3(0, -ringsPerBone * segmentHeight, 0));
+            file.WriteInt32(boneVertexCount);
+            file.WriteInt32(firstVertex);
+
+            file.WriteInt32(1);
+            file.WriteObject(Double3(0));
+            file.WriteDouble(200.0);
+            file.WriteInt32(firstVertex);
+            file.WriteInt32(boneVertexCount);
+
+            firstVertex += boneVertexCount;
+        }
+
+        // Unknown position and distance
+        for (int i = 0; i < 4; ++i)
+            file.WriteDouble(0);
+
+        // Fire, omni lights, anchors
+        file.WriteInt32(0);
+        file.WriteInt32(0);
+        file.WriteInt32(1);
+        file.WriteString("gen_anchor");
+        WriteMatrix(file, Double3(0));
+        file.WriteInt32(0);
+
+        // Edges, spikes, groups, mutilations, trails
+        file.WriteInt32(5);
+        file.WriteInt32(0);
+        file.WriteInt32(0);
+        file.WriteInt32(faceCount);
+        WritePadding(file, faceCount, 1);
+        file.WriteInt32(0);
+        file.WriteInt32(0);
+        return true;
+    }
+
+    bool WriteAnimation(StringView fileName, GeneratorSettings const& settings)
+    {
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        int boneCount = Math::Max(1, settings.BoneCount);
+
+        file.WriteString(PathUtils::sGetFilenameNoExt(fileName));
+
+        file.WriteInt32(boneCount);
+        for (int bone = 0; bone < boneCount; ++bone)
+        {
+            file.WriteInt32(settings.FrameCount);
+            for (int frame = 0; frame < settings.FrameCount; ++frame)
+            {
+                double angle = 0.2 * std::sin(TwoPi * frame / settings.FrameCount + bone);
+                // W, X, Y, Z
+                file.WriteFloat(float(std::cos(angle * 0.5)));
+                file.WriteFloat(float(std::sin(angle * 0.5)));
+                file.WriteFloat(0.0f);
+                file.WriteFloat(0.0f);
+            }
+        }
+
+        file.WriteInt32(settings.FrameCount);
+        for (int frame = 0; frame < settings.FrameCount; ++frame)
+            file.WriteObject(Double3(frame * 10.0, 0, 0));
+        return true;
+    }
+
+    bool WriteLevel(StringView fileName, StringView name)
+    {
+        File file = File::sOpenWrite(fileName);
+        if (!file)
+            return false;
+
+        String str;
+        str = String("Bitmaps -> ") + name + ".mmp\n";
+        file.Write(str.CStr(), str.Size());
+        str = String("WorldDome -> ") + name + "_d.mmp\n";
+        file.Write(str.CStr(), str.Size());
+        str = String("World -> ") + name + ".bw\n";
+        file.Write(str.CStr(), str.Size());
+        return true;
+    }
+
+    void PrintUsage(const char* exe)
+    {
+        fprintf(stderr,
+            "Usage: %s <output directory> [options]\n"
+            "  --name <name>         Base file name (default gen)\n"
+            "  --sectors <N>         Sector count (default 150, about casa.lvl)\n"
+            "  --faces <M>           Faces per sector, 6..100 (default 12)\n"
+            "  --portals <P>         Portals per connecting wall, > 1 writes multiple portal faces (default 1)\n"
+            "  --bsp-depth <D>       BSP depth of multiple portal faces (default 3)\n"
+            "  --scale <X>           Multiplies the sector count (default 1)\n"
+            "  --textures <T>        Texture count in the pack (default 32)\n"
+            "  --tex-size <S>        Texture width and height (default 256)\n"
+            "  --bones <K>           Model bone count (default 20)\n"
+            "  --model-faces <F>     Approximate model face count (default 2000)\n"
+            "  --frames <R>          Animation frame count (default 60)\n"
+            "  --seed <S>            Random seed (default 1)\n",
+            exe);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    GeneratorSettings settings;
+    const char* outputDir = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        auto intArg = [&](const char* key, int& out)
+            {
+                if (strcmp(arg, key) || !value)
+                    return false;
+                out = atoi(value);
+                ++i;
+                return true;
+            };
+
+        int seed;
+        if (intArg("--sectors", settings.SectorCount) ||
+            intArg("--faces", settings.FacesPerSector) ||
+            intArg("--portals", settings.PortalsPerWall) ||
+            intArg("--bsp-depth", settings.BSPDepth) ||
+            intArg("--scale", settings.Scale) ||
+            intArg("--textures", settings.TextureCount) ||
+            intArg("--tex-size", settings.TextureSize) ||
+            intArg("--bones", settings.BoneCount) ||
+            intArg("--model-faces", settings.ModelFaces) ||
+            intArg("--frames", settings.FrameCount))
+            continue;
+        if (intArg("--seed", seed))
+        {
+            settings.Seed = seed ? seed : 1;
+            continue;
+        }
+        if (!strcmp(arg, "--name") && value)
+        {
+            settings.Name = value;
+            ++i;
+            continue;
+        }
+        if (arg[0] == '-')
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        outputDir = arg;
+    }
+
+    if (!outputDir)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    settings.SectorCount = Math::Max(1, settings.SectorCount);
+    settings.FacesPerSector = Math::Clamp(settings.FacesPerSector, 6, 100);
+    settings.PortalsPerWall = Math::Max(1, settings.PortalsPerWall);
+    settings.Scale = Math::Max(1, settings.Scale);
+    settings.TextureCount = Math::Max(1, settings.TextureCount);
+    settings.TextureSize = Math::Max(1, settings.TextureSize);
+    settings.FrameCount = Math::Max(1, settings.FrameCount);
+
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+
+    String base = String(outputDir) / settings.Name.c_str();
+
+    WorldWriter world(settings);
+    if (!world.Write(base + ".bw") ||
+        !WriteTexturePack(base + ".mmp", settings) ||
+        !WriteDome(base + "_d.mmp", settings) ||
+        !WriteModel(base + ".BOD", settings) ||
+        !WriteAnimation(base + ".BMV", settings) ||
+        !WriteLevel(base + ".lvl", settings.Name.c_str()))
+    {
+        fprintf(stderr, "Failed to write %s\n", base.CStr());
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %d sectors, %d faces, %d portals, %d BSP nodes\n",
+        base.CStr(), settings.SectorCount * settings.Scale, world.FaceCount, world.PortalCount, world.NodeCount);
+    return 0;
+}
@@ -0,0 +1,484 @@
+/*
+
+Open source re-implementation of Blade Of Darkness.
+
+MIT License
+
+Copyright (C) 2025 Alexander Samusev.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+// Headless benchmark for the Source/DataFormats loaders.
+//
+// Usage: openblade_bench <game directory> [-o results.json] [-r repeat count] [-j thread count]
+//
+// Walks the game directory and times every loader on every file it understands.
+// Nothing here touches the renderer, so the numbers are pure parsing/decoding cost.
+
+#include "DataFormats/BW.h"
+#include "DataFormats/BOD.h"
+#include "DataFormats/BMV.h"
+#include "DataFormats/CAM.h"
+#include "DataFormats/SF.h"
+#include "DataFormats/CSV.h"
+#include "DataFormats/MMP.h"
+#include "Utils/ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace Hk;
+
+namespace
+{
+    std::atomic<uint64_t> AllocationCount{0};
+    std::atomic<uint64_t> AllocatedBytes{0};
+}
+
+#if defined(__GLIBC__)
+// Both operator new and the engine heap end up in malloc, so on glibc interpose it directly.
+// Aligned allocations (including aligned operator new) go through the memalign family.
+#define ALLOCATION_COUNTING "malloc, calloc, realloc, memalign, aligned_alloc, posix_memalign"
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+
+    void* malloc(size_t size)
+    {
+        AllocationCount.fetch_add(1, std::memory_order_relaxed);
+        AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        AllocationCount.fetch_add(1, std::memory_order_relaxed);
+        AllocatedBytes.fetch_add(count * size, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size)
+    {
+        AllocationCount.fetch_add(1, std::memory_order_relaxed);
+        AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_realloc(p, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        AllocationCount.fetch_add(1, std::memory_order_relaxed);
+        AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        return memalign(alignment, size);
+    }
+
+    int posix_memalign(void** p, size_t alignment, size_t size)
+    {
+        if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        void* ptr = memalign(alignment, size);
+        if (!ptr && size)
+            return ENOMEM;
+
+        *p = ptr;
+        return 0;
+    }
+}
+#else
+// Elsewhere only allocations made through the plain operator new are counted. Aligned operator new and direct
+// malloc calls are missing from the numbers.
+#define ALLOCATION_COUNTING "operator new"
+
+void* operator new(size_t size)
+{
+    AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+#endif
+
+namespace
+{
+    struct BenchResult
+    {
+        std::string Loader;
+        std::string File;
+        uint64_t    FileSize = 0;
+        double      BestMs = 0;
+        double      AvgMs = 0;
+        uint64_t    Allocations = 0;
+        uint64_t    AllocatedBytes = 0;
+        uint64_t    PeakRSS = 0;
+        bool        Succeeded = true;
+    };
+
+    uint64_t GetPeakRSS()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.PeakWorkingSetSize;
+        return 0;
+#elif defined(__linux__)
+        // ru_maxrss can't be reset, VmHWM follows the reset in ResetPeakRSS
+        uint64_t peak = 0;
+        if (FILE* f = fopen("/proc/self/status", "r"))
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), f))
+            {
+                if (!strncmp(line, "VmHWM:", 6))
+                {
+                    peak = strtoull(line + 6, nullptr, 10) * 1024;
+                    break;
+                }
+            }
+            fclose(f);
+        }
+        return peak;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return usage.ru_maxrss;
+#else
+        return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    // Resets the high water mark of the resident set (VmHWM) so each file gets its own peak (Linux only).
+    // Elsewhere the peak is the process-wide maximum so far.
+    void ResetPeakRSS()
+    {
+#ifdef __linux__
+        if (FILE* f = fopen("/proc/self/clear_refs", "w"))
+        {
+            fputs("5", f);
+            fclose(f);
+        }
+#endif
+    }
+
+    bool DecodeMMP(StringView fileName)
+    {
+        File file = File::sOpenRead(fileName);
+        if (!file)
+            return false;
+
+        HeapBlob trueColor;
+
+        int32_t texCount = file.ReadInt32();
+        for (int32_t i = 0; i < texCount; ++i)
+        {
+            BladeMMP::TextureHeader header;
+            if (!BladeMMP::ReadHeader(file, header))
+                return false;
+
+            HeapBlob textureData = file.ReadBlob(header.DataSize);
+
+            size_t rgbaSize = size_t(header.Width) * header.Height * 4;
+            if (trueColor.Size() < rgbaSize)
+                trueColor.Reset(rgbaSize);
+
+            BladeMMP::Decode(header, textureData.GetData(), trueColor.GetData());
+        }
+        return true;
+    }
+
+    template <typename LoadFunc>
+    BenchResult Measure(const char* loader, std::filesystem::path const& path, int repeatCount, LoadFunc load)
+    {
+        BenchResult result;
+        result.Loader = loader;
+        result.File = path.generic_string();
+
+        std::error_code ec;
+        result.FileSize = std::filesystem::file_size(path, ec);
+
+        ResetPeakRSS();
+
+        double totalMs = 0;
+        for (int i = 0; i < repeatCount; ++i)
+        {
+            uint64_t allocations = AllocationCount.load(std::memory_order_relaxed);
+            uint64_t allocatedBytes = AllocatedBytes.load(std::memory_order_relaxed);
+
+            auto start = std::chrono::steady_clock::now();
+            bool succeeded = load(StringView(result.File.c_str()));
+            auto end = std::chrono::steady_clock::now();
+
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+            totalMs += ms;
+            if (i == 0 || ms < result.BestMs)
+                result.BestMs = ms;
+
+            // The first run is representative of a cold level start
+            if (i == 0)
+            {
+                result.Allocations = AllocationCount.load(std::memory_order_relaxed) - allocations;
+                result.AllocatedBytes = AllocatedBytes.load(std::memory_order_relaxed) - allocatedBytes;
+                result.Succeeded = succeeded;
+            }
+        }
+        result.AvgMs = totalMs / repeatCount;
+        result.PeakRSS = GetPeakRSS();
+        return result;
+    }
+
+    std::string EscapeJson(std::string const& str)
+    {
+        std::string out;
+        out.reserve(str.size());
+        for (char ch : str)
+        {
+            switch (ch)
+            {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20)
+                    {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                        out += buf;
+                    }
+                    else
+                        out += ch;
+                    break;
+            }
+        }
+        return out;
+    }
+
+    void WriteJson(FILE* out, std::vector<BenchResult> const& results, int repeatCount)
+    {
+        fprintf(out, "{\n  \"repeat\": %d,\n  \"threads\": %zu,\n  \"allocation_counting\": \"%s\",\n  \"results\": [\n",
+            repeatCount, GetParallelThreadCount(), ALLOCATION_COUNTING);
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            BenchResult const& r = results[i];
+            double mbPerSecond = r.BestMs > 0 ? (r.FileSize / (1024.0 * 1024.0)) / (r.BestMs / 1000.0) : 0;
+
+            fprintf(out,
+                "    {\"loader\": \"%s\", \"file\": \"%s\", \"ok\": %s, \"bytes\": %llu, \"best_ms\": %.4f, \"avg_ms\": %.4f, "
+                "\"mb_per_s\": %.2f, \"allocations\": %llu, \"allocated_bytes\": %llu, \"peak_rss\": %llu}%s\n",
+                r.Loader.c_str(),
+                EscapeJson(r.File).c_str(),
+                r.Succeeded ? "true" : "false",
+                (unsigned long long)r.FileSize,
+                r.BestMs,
+                r.AvgMs,
+                mbPerSecond,
+                (unsigned long long)r.Allocations,
+                (unsigned long long)r.AllocatedBytes,
+                (unsigned long long)r.PeakRSS,
+                i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+    std::string ToLower(std::string str)
+    {
+        for (char& ch : str)
+            ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        return str;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* gameDir = nullptr;
+    const char* outputName = nullptr;
+    int repeatCount = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-o" || arg == "--output") && i + 1 < argc)
+            outputName = argv[++i];
+        else if ((arg == "-r" || arg == "--repeat") && i + 1 < argc)
+            repeatCount = std::max(1, atoi(argv[++i]));
+        else if ((arg == "-j" || arg == "--threads") && i + 1 < argc)
+            SetParallelThreadCount(std::max(0, atoi(argv[++i])));
+        else
+            gameDir = argv[i];
+    }
+
+    if (!gameDir)
+    {
+        fprintf(stderr, "Usage: %s <game directory> [-o results.json] [-r repeat count] [-j thread count]\n", argv[0]);
+        return 1;
+    }
+
+    std::error_code ec;
+    std::vector<std::filesystem::path> files;
+    for (auto it = std::filesystem::recursive_directory_iterator(gameDir, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (it->is_regular_file(ec))
+            files.push_back(it->path());
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<BenchResult> results;
+
+    for (auto const& path : files)
+    {
+        std::string ext = ToLower(path.extension().string());
+
+        if (ext == ".bw")
+        {
+            results.push_back(Measure("BladeWorld", path, repeatCount, [](StringView name)
+                {
+                    BladeWorld bw;
+                    return bw.Load(name);
+                }));
+        }
+        else if (ext == ".bod")
+        {
+            results.push_back(Measure("BladeModel", path, repeatCount, [](StringView name)
+                {
+                    BladeModel model;
+                    model.Load(name);
+                    return !model.Vertices.IsEmpty();
+                }));
+        }
+        else if (ext == ".bmv")
+        {
+            results.push_back(Measure("BladeAnimation", path, repeatCount, [](StringView name)
+                {
+                    BladeAnimation anim;
+                    anim.Load(name);
+                    return !anim.BoneTransforms.IsEmpty();
+                }));
+        }
+        else if (ext == ".cam")
+        {
+            results.push_back(Measure("BladeCAM", path, repeatCount, [](StringView name)
+                {
+                    BladeCAM cam;
+                    cam.Load(name);
+                    return !cam.Frames.IsEmpty();
+                }));
+        }
+        else if (ext == ".sf")
+        {
+            results.push_back(Measure("BladeSF", path, repeatCount, [](StringView name)
+                {
+                    BladeSF sf;
+                    sf.Load(name);
+                    return true;
+                }));
+        }
+        else if (ext == ".csv")
+        {
+            results.push_back(Measure("BladeCSV", path, repeatCount, [](StringView name)
+                {
+                    BladeCSV csv;
+                    csv.Load(name);
+                    return true;
+                }));
+        }
+        else if (ext == ".mmp")
+        {
+            results.push_back(Measure("BladeMMP", path, repeatCount, DecodeMMP));
+        }
+        else
+            continue;
+
+        fprintf(stderr, "%-16s %8.3f ms  %s\n", results.back().Loader.c_str(), results.back().BestMs, results.back().File.c_str());
+    }
+
+    FILE* out = stdout;
+    if (outputName)
+    {
+        out = fopen(outputName, "w");
+        if (!out)
+        {
+            fprintf(stderr, "Failed to open %s\n", outputName);
+            return 1;
+        }
+    }
+
+    WriteJson(out, results, repeatCount);
+
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
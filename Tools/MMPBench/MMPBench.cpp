@@ -0,0 +1,136 @@
+// Micro-benchmark for the MMP pixel expansion kernels.
+//
+// Usage: openblade_mmpbench [-s image size] [-r repeat count]
+//
+// Expands random palette, grayscale and RGB images with every kernel the CPU supports,
+// checks the output against the scalar reference and prints megapixels per second.
+
+#include "DataFormats/MMP.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Hk;
+
+namespace
+{
+    enum SOURCE_TYPE
+    {
+        SOURCE_PALETTE,
+        SOURCE_GRAYSCALE,
+        SOURCE_RGB
+    };
+
+    const char* GetSourceName(SOURCE_TYPE type)
+    {
+        switch (type)
+        {
+            case SOURCE_PALETTE:
+                return "palette";
+            case SOURCE_GRAYSCALE:
+                return "grayscale";
+            case SOURCE_RGB:
+                return "rgb";
+        }
+        return "unknown";
+    }
+
+    void Expand(SOURCE_TYPE type, std::vector<uint8_t> const& src, size_t pixelCount, uint8_t* rgba, BladeMMP::KERNEL kernel)
+    {
+        switch (type)
+        {
+            case SOURCE_PALETTE:
+                BladeMMP::ExpandPalette(src.data(), src.data() + pixelCount, pixelCount, rgba, kernel);
+                break;
+            case SOURCE_GRAYSCALE:
+                BladeMMP::ExpandGrayscale(src.data(), pixelCount, rgba, kernel);
+                break;
+            case SOURCE_RGB:
+                BladeMMP::ExpandRGB(src.data(), pixelCount, rgba, kernel);
+                break;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t imageSize = 1024;
+    int repeatCount = 50;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-s" || arg == "--size") && i + 1 < argc)
+            imageSize = std::max(1, atoi(argv[++i]));
+        else if ((arg == "-r" || arg == "--repeat") && i + 1 < argc)
+            repeatCount = std::max(1, atoi(argv[++i]));
+        else
+        {
+            fprintf(stderr, "Usage: %s [-s image size] [-r repeat count]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t pixelCount = imageSize * imageSize;
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> byteDist(0, 255);
+
+    std::vector<uint8_t> reference(pixelCount * 4);
+    std::vector<uint8_t> output(pixelCount * 4);
+
+    bool allMatch = true;
+
+    printf("%-10s %-8s %12s %12s\n", "source", "kernel", "best ms", "MP/s");
+
+    for (SOURCE_TYPE type : {SOURCE_PALETTE, SOURCE_GRAYSCALE, SOURCE_RGB})
+    {
+        // Palette images carry 768 bytes of 6-bit palette after the indices
+        size_t srcSize = type == SOURCE_PALETTE ? pixelCount + 768 : type == SOURCE_GRAYSCALE ? pixelCount : pixelCount * 3;
+        std::vector<uint8_t> src(srcSize);
+        for (size_t i = 0; i < srcSize; ++i)
+            src[i] = uint8_t(byteDist(rng));
+        if (type == SOURCE_PALETTE)
+        {
+            for (size_t i = pixelCount; i < srcSize; ++i)
+                src[i] &= 63;
+        }
+
+        Expand(type, src, pixelCount, reference.data(), BladeMMP::KERNEL_SCALAR);
+
+        for (BladeMMP::KERNEL kernel : {BladeMMP::KERNEL_SCALAR, BladeMMP::KERNEL_SSSE3, BladeMMP::KERNEL_AVX2, BladeMMP::KERNEL_NEON})
+        {
+            if (!BladeMMP::IsKernelSupported(kernel))
+                continue;
+
+            std::memset(output.data(), 0, output.size());
+
+            double bestMs = 0;
+            for (int i = 0; i < repeatCount; ++i)
+            {
+                auto start = std::chrono::steady_clock::now();
+                Expand(type, src, pixelCount, output.data(), kernel);
+                auto end = std::chrono::steady_clock::now();
+
+                double ms = std::chrono::duration<double, std::milli>(end - start).count();
+                if (i == 0 || ms < bestMs)
+                    bestMs = ms;
+            }
+
+            bool match = output == reference;
+            allMatch = allMatch && match;
+
+            double megapixels = bestMs > 0 ? pixelCount / (bestMs * 1000.0) : 0;
+
+            printf("%-10s %-8s %12.4f %12.1f%s\n", GetSourceName(type), BladeMMP::GetKernelName(kernel), bestMs, megapixels, match ? "" : "  MISMATCH");
+        }
+    }
+
+    return allMatch ? 0 : 1;
+}